@@ -54,3 +54,107 @@ bool POS::Attacked(int sq, eColor sd) const {
            (StraightMovers(sd)) & BB.RookAttacks(OccBb(), sq) ||
            (Kings(sd) & BB.KingAttacks(sq));
 }
+
+// Pieces of either side that stand alone between the king on ksq and a slider
+// of side sd that would attack it on an empty board
+
+U64 POS::Blockers(int ksq, eColor sd) const {
+
+    U64 bb_snipers = (BB.bbRookPseudo[ksq] & StraightMovers(sd))
+                   | (BB.bbBishPseudo[ksq] & DiagMovers(sd));
+    U64 bb_blockers = 0ULL;
+
+    while (bb_snipers) {
+        U64 bb_ray = BB.bbBetween[PopFirstBit(&bb_snipers)][ksq] & OccBb();
+        if (bb_ray && !(bb_ray & (bb_ray - 1)))
+            bb_blockers |= bb_ray;
+    }
+
+    return bb_blockers;
+}
+
+// Check information for the side to move, so that InCheck() is a test of a
+// bitboard, Illegal() can often skip the attack test, and GivesCheck() and
+// GenerateSpecial() need no attack generation. Checkers are found on every
+// move (DoMove() knows from GivesCheck() whether there can be any at all).
+// The rest is completed once per position, when the first move is made or
+// tested from it, as most quiescence nodes never get that far.
+
+void POS::InitCheckInfo(bool maybe_check) {
+
+    mCheck.checkers = maybe_check ? AttacksTo(KingSq(mSide)) & mClBb[~mSide] : 0ULL;
+    mCheck.ready = false;
+    mCheck.moverSafe = false;
+}
+
+void POS::CompleteCheckInfo() {
+
+    eColor sd = mSide;
+    eColor op = ~sd;
+    int king_sq = KingSq(op);
+
+    mCheck.pinned = Blockers(KingSq(sd), op) & mClBb[sd];
+    mCheck.discoverers = Blockers(king_sq, sd) & mClBb[sd];
+
+    mCheck.checkSq[P] = BB.PawnAttacks(op, king_sq);
+    mCheck.checkSq[N] = BB.KnightAttacks(king_sq);
+    mCheck.checkSq[B] = BB.BishAttacks(OccBb(), king_sq);
+    mCheck.checkSq[R] = BB.RookAttacks(OccBb(), king_sq);
+    mCheck.checkSq[Q] = mCheck.checkSq[B] | mCheck.checkSq[R];
+    mCheck.checkSq[K] = 0ULL;
+
+    mCheck.ready = true;
+}
+
+// Does a pseudo-legal move of the side to move give check?
+
+bool POS::GivesCheck(int move) {
+
+    if (!mCheck.ready) CompleteCheckInfo();
+
+    eColor sd = mSide;
+    int fsq = Fsq(move);
+    int tsq = Tsq(move);
+    int king_sq = KingSq(~sd);
+    U64 bb_occ;
+
+    // discovered check: a blocker leaves the line between a slider and the king
+
+    if ((mCheck.discoverers & SqBb(fsq))
+    && !(BB.bbBetween[king_sq][fsq] & SqBb(tsq))
+    && !(BB.bbBetween[king_sq][tsq] & SqBb(fsq)))
+        return true;
+
+    switch (MoveType(move)) {
+        case NORMAL: case EP_SET:
+            return (mCheck.checkSq[TpOnSq(fsq)] & SqBb(tsq)) != 0;
+
+        case CASTLE: // only the rook can give check
+            switch (tsq) {
+                case C1: { fsq = A1; tsq = D1; break; }
+                case G1: { fsq = H1; tsq = F1; break; }
+                case C8: { fsq = A8; tsq = D8; break; }
+                case G8: { fsq = H8; tsq = F8; break; }
+            }
+            bb_occ = (OccBb() ^ SqBb(KingSq(sd)) ^ SqBb(fsq)) | SqBb(tsq) | SqBb(Tsq(move));
+            return (BB.RookAttacks(bb_occ, tsq) & SqBb(king_sq)) != 0;
+
+        case EP_CAP: // the captured pawn may uncover a check, too
+            if (mCheck.checkSq[P] & SqBb(tsq))
+                return true;
+            bb_occ = OccBb() ^ SqBb(fsq) ^ SqBb(tsq) ^ SqBb(tsq ^ 8);
+            return (BB.BishAttacks(bb_occ, king_sq) & DiagMovers(sd))
+                || (BB.RookAttacks(bb_occ, king_sq) & StraightMovers(sd));
+    }
+
+    // promotions
+
+    bb_occ = (OccBb() ^ SqBb(fsq)) | SqBb(tsq);
+
+    switch (PromType(move)) {
+        case N: return (BB.KnightAttacks(tsq) & SqBb(king_sq)) != 0;
+        case B: return (BB.BishAttacks(bb_occ, tsq) & SqBb(king_sq)) != 0;
+        case R: return (BB.RookAttacks(bb_occ, tsq) & SqBb(king_sq)) != 0;
+    }
+    return (BB.QueenAttacks(bb_occ, tsq) & SqBb(king_sq)) != 0;
+}
@@ -61,6 +61,21 @@ void cBitBoard::Init() {
         }
     }
 
+    // init slider attacks on an empty board
+
+    for (int sq1 = 0; sq1 < 64; sq1++) {
+        bbRookPseudo[sq1] = bbBishPseudo[sq1] = 0ULL;
+        for (int sq2 = 0; sq2 < 64; sq2++) {
+            if (sq1 == sq2) continue;
+            int file_dist = File(sq2) - File(sq1);
+            int rank_dist = Rank(sq2) - Rank(sq1);
+            if (file_dist == 0 || rank_dist == 0)
+                bbRookPseudo[sq1] |= SqBb(sq2);
+            if (file_dist == rank_dist || file_dist == -rank_dist)
+                bbBishPseudo[sq1] |= SqBb(sq2);
+        }
+    }
+
 }
 
 // from Laser, originally from chessprogramming wiki
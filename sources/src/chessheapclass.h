@@ -2,73 +2,176 @@
 #include <cstdlib>
 #include <cstring>
 
+#if defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+#endif
+
+// The table is a single allocation of 64-byte clusters, addressed by 64-bit
+// cluster numbers. A key is mapped to a cluster by the high half of the 128-bit
+// product key * tt_size, which spreads keys evenly over a table of any size
+// (not just a power of two) at the cost of one multiplication.
 
 class ChessHeapClass {
-    static constexpr int bucket_size_mb = 512;
-    static constexpr int num_per_bucket = bucket_size_mb * 1024 * 1024 / sizeof(ENTRY);
-    static constexpr int arrays_size = max_tt_size_mb / bucket_size_mb;
+    static constexpr int cluster_entries = 6;
 
-    static_assert(sizeof(ENTRY) == 16, "ENTRY size must be 16 bytes.");
+    static_assert(sizeof(sTTCluster) == 64, "sTTCluster size must be 64 bytes.");
+    static_assert(ATOMIC_SHORT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "sTTCluster must not hide locks (shared memory).");
 
-    int    bucket_sizs[arrays_size];
-    ENTRY *bucket_ptrs[arrays_size];
+    sTTCluster *table;      // aligned to 64 bytes
+    void *table_mem;        // as returned by malloc(), NULL if the table is mmap()-ed
 
-    unsigned int tt_size;
-    unsigned int tt_mask;
+    U64 tt_size;            // number of clusters
 
     bool success;
 
-    void Free() {           // free the allocated memory and zeroize bucket_ptrs[]
+    int mem_policy;         // one of MEM_INTERLEAVE, MEM_FIRST_TOUCH, MEM_MALLOC
+    unsigned int prev_size; // size of the current allocation in megabytes
+    size_t map_size;        // size of the mmap()-ed region, 0 if the table comes from malloc()
+    char mem_mode[192];     // what the allocation actually got, for reporting (fits the shm_object name)
 
-        for (int i = 0; i < arrays_size && bucket_ptrs[i]; i++) {
-            free(bucket_ptrs[i]);
-            bucket_ptrs[i] = NULL;
-        }
+    char shm_name[64];      // `Shared Hash` option, empty if the table is private
+    char shm_object[96];    // shared memory object in use, empty if none
+    bool shm_owner;         // shm_object was created by this engine
+    std::atomic<int> *shm_date; // search counter after the clusters of a shared table, NULL if private
+
+    bool MapPages(int size_mb);
+    bool MapShared(int size_mb);
+    const char *PlacePages(void *mem, size_t size) const;
+    static void Release(sTTCluster *mapped, void *mem, size_t mapped_size);
+
+    void Free() {           // free the allocated memory and zeroize table
+
+        Release(table, table_mem, map_size);
+        table_mem = NULL;
+        table = NULL;
+        map_size = 0;
+        shm_date = NULL;
     }
 
-    void ZeroMem() {        // zeroize the allocated memory
+    bool Resize(unsigned int size_mb);
+    void Rebuild(const sTTCluster *old_table, U64 old_size); // zeroize the table and move old entries into it, in parallel
+    void RebuildClusters(U64 first, U64 last, const sTTCluster *old_table, U64 old_size);
+    void Insert(sTTCluster *cluster, uint16_t fragment, U64 data, unsigned pos) const;
+
+    sTTCluster *MakeAddr(U64 cluster_number) const { // calculate address of the cluster with cluster_number
 
-        if (success)
-            for (int i = 0; i < arrays_size && bucket_ptrs[i]; i++)
-                memset(bucket_ptrs[i], 0, 1024 * 1024 * bucket_sizs[i]);
+        return table + cluster_number;
     }
 
-    ENTRY *MakeAddr(int entry_number) const {     // calculate address of the entry with entry_number
+    static U64 MulHi(U64 a, U64 b) {
+
+#if defined(__GNUC__) && defined(__SIZEOF_INT128__)
+        return (U64)(((unsigned __int128)a * b) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        return __umulh(a, b);
+#else
+        const U64 a_lo = (uint32_t)a, a_hi = a >> 32;
+        const U64 b_lo = (uint32_t)b, b_hi = b >> 32;
+        const U64 mid = (a_lo * b_lo >> 32) + (uint32_t)(a_hi * b_lo) + a_lo * b_hi;
+        return a_hi * b_hi + (a_hi * b_lo >> 32) + (mid >> 32);
+#endif
+    }
 
-        const int num_of_bucket = entry_number / num_per_bucket;
+    sTTCluster *ClusterOf(U64 key) const { return MakeAddr(MulHi(key, tt_size)); }
 
-        return bucket_ptrs[num_of_bucket] + entry_number - num_per_bucket * num_of_bucket;
+    // The top bits of the low half of key * tt_size tell where the key falls
+    // between its cluster and the next one. Five of them are kept per entry, so
+    // that a resize can find the new cluster of the entry without knowing its key.
+    // They are covered by the check in the key slot, like the data word.
+
+    static unsigned KeyPos(U64 key, U64 size) { return (unsigned)((key * size) >> 59); }
+    static unsigned EntryPos(uint32_t pos, int i) { return (pos >> (5 * i)) & 31; }
+
+    static void SetEntryPos(sTTCluster *cluster, int i, unsigned pos) { // other threads may set other entries at once
+
+        uint32_t old = cluster->pos.load(std::memory_order_relaxed);
+        while (EntryPos(old, i) != pos
+        &&     !cluster->pos.compare_exchange_weak(old, (old & ~(31u << (5 * i))) | pos << (5 * i), std::memory_order_relaxed)) {}
     }
 
-    bool Alloc(int size_mb) {       // allocate size_mb megabyte of memory and return true on success
+    bool Alloc(int size_mb) {       // allocate size_mb megabyte of memory for an empty table and return true on success
 
         if (size_mb > max_tt_size_mb)
             return false;
 
-        Free();
+        if (shm_name[0])
+            return MapShared(size_mb);
+
+        if (mem_policy != MEM_MALLOC && MapPages(size_mb))
+            return true;
 
-        success = true;
-        for (int i = 0; size_mb > 0 && success; i++) {
-            bucket_sizs[i] = size_mb > bucket_size_mb ? bucket_size_mb : size_mb;
-            bucket_ptrs[i] = (ENTRY *) malloc(1024 * 1024 * bucket_sizs[i]);
-            success = bucket_ptrs[i] != NULL;
-            size_mb -= bucket_size_mb;
+        table_mem = malloc((size_t)size_mb * 1024 * 1024 + sizeof(sTTCluster));
+        if (table_mem == NULL)
+            return false;
 
-            if (success)
-                printf_debug("allocated: %dMB\n", bucket_sizs[i]);
+        table = (sTTCluster *)(((uintptr_t)table_mem + sizeof(sTTCluster) - 1) & ~(uintptr_t)(sizeof(sTTCluster) - 1));
+        snprintf(mem_mode, sizeof(mem_mode), "default pages (malloc)");
+        printf_debug("allocated: %dMB\n", size_mb);
+
+        return true;
+    }
+
+    // An entry is a 16-bit key slot plus one 64-bit data word, so a cluster of
+    // 64 bytes holds six of them. Entries are read and written without locks.
+    // The data word holds the static eval of the position, which leaves no room
+    // for key bits in it. Instead, the key slot holds the low 16 bits of the key
+    // xor-ed with a 16-bit check of the data word and the position bits, so a
+    // probe that races with a store and reads the key slot of one entry with the
+    // data (or position bits) of another sees a mismatch and a miss. The date is
+    // left out of the check, so that refreshing it doesn't touch the key slot. The cluster index and the 16 key
+    // bits are all that identify a position, as in most engines with small
+    // entries; the search verifies hash moves for legality before playing them.
+
+    static uint16_t KeyFragment(U64 key) { return (uint16_t)key; }
+
+    static uint16_t DataCheck(U64 data, unsigned pos) { return (uint16_t)((((data & ~(63ULL << 58)) | (U64)pos << 58) * 0x9E3779B97F4A7C15ULL) >> 48); }
+
+    static U64 PackData(int move, int score, int eval, int depth, int flags, int date) {
+        return (U64)(uint16_t)move
+             | (U64)(uint16_t)score << 16
+             | (U64)(uint16_t)eval << 32
+             | (U64)(uint8_t)depth << 48
+             | (U64)(flags & 3) << 56
+             | (U64)(date & 63) << 58;
+    }
+
+    static int DataMove(U64 data)  { return (int)(data & 0xFFFF); }
+    static int DataScore(U64 data) { return (int16_t)(data >> 16); }
+    static int DataEval(U64 data)  { return (int16_t)(data >> 32); }
+    static int DataDepth(U64 data) { return (int)(data >> 48) & 255; }
+    static int DataFlags(U64 data) { return (int)(data >> 56) & 3; }
+    static int DataDate(U64 data)  { return (int)(data >> 58); }
+
+    int FindEntry(sTTCluster *cluster, U64 key, U64 *data) const { // returns entry index or -1
+
+        const uint16_t fragment = KeyFragment(key);
+        const uint32_t pos = cluster->pos.load(std::memory_order_relaxed);
+
+        for (int i = 0; i < cluster_entries; i++) {
+            *data = cluster->data[i].load(std::memory_order_relaxed);
+            if ((cluster->key[i].load(std::memory_order_relaxed) ^ DataCheck(*data, EntryPos(pos, i))) == fragment
+            &&  DataFlags(*data) != NONE) return i; // skip empty (zeroed) slots
         }
 
-        if (!success)
-            Free();
+        return -1;
+    }
+
+    int Staleness(U64 data) const { // the entry to replace is the one with the highest staleness
+        return ((tt_date - DataDate(data)) & 63) * 256 + 255 - DataDepth(data);
+    }
 
-        return success;
+    void RefreshEntry(sTTCluster *cluster, int i, U64 data) const {
+        if (DataDate(data) != (tt_date & 63))
+            cluster->data[i].store((data & ~(63ULL << 58)) | (U64)(tt_date & 63) << 58, std::memory_order_relaxed);
     }
 
   public:
 
+    enum { MEM_INTERLEAVE, MEM_FIRST_TOUCH, MEM_MALLOC };
+
     int tt_date;
 
-    ChessHeapClass(): bucket_ptrs{}, success{false} {};
+    ChessHeapClass(): table{}, table_mem{}, success{false}, mem_policy{MEM_INTERLEAVE}, prev_size{0}, map_size{0}, mem_mode{}, shm_name{}, shm_object{}, shm_owner{false}, shm_date{} {};
 
     ~ChessHeapClass() {
 
@@ -76,8 +179,19 @@ class ChessHeapClass {
     }
 
     void AllocTrans(unsigned int mbsize);
+    void SetMemPolicy(int policy);
+    void SetShared(const char *name);
+    bool Shared() const { return shm_object[0] != '\0'; }
+    const char *MemMode() const { return mem_mode; }
     void Clear();
-    bool Retrieve(U64 key, int *move, int *score, int *flag, int alpha, int beta, int depth, int ply);
+    void NewSearch();
+    void Prefetch(U64 key) const { if (success) PREFETCH(ClusterOf(key)); }
+    bool Probe(U64 key, int ply, sHashEntry *entry);
     void RetrieveMove(U64 key, int *move);
-    void Store(U64 key, int move, int score, int flags, int depth, int ply);
+    eHashStore Store(U64 key, int move, int score, int eval, int flags, int depth, int ply);
+    int Hashfull() const;
+    void PrintStats() const;
+    void Save(const char *file_name) const;
+    void Load(const char *file_name);
+    static void StressTest(int threads);
 };
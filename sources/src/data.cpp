@@ -25,7 +25,7 @@ const int ph_value[7] = {   0,   1,   1,   2,    4,  0,   0 }; // any change req
 U64 POS::msZobPiece[12][64];
 U64 POS::msZobCastle[16];
 U64 POS::msZobEp[8];
-int tDepth[MAX_THREADS];
+U64 POS::msZobMaterial[12][16];
 int cEngine::msMoveTime;
 int cEngine::msMoveNodes;
 int cEngine::msSearchDepth;
@@ -124,6 +124,7 @@ double cEngine::TexelFit(POS *p, int *pv) {
     double k_const = 1.250;
     int iteration = 0;
     Trans.Clear();
+    PawnHash.Clear();
     ClearAll();
 
     double result = 1;
@@ -23,17 +23,20 @@ If not, see <http://www.gnu.org/licenses/>.
 
 void cEngine::ClearAll() {
 
-    ClearPawnHash();
     ClearEvalHash();
     ClearHist();
+    ZEROARRAY(mHashStores);
 }
 
 void cEngine::ClearEvalHash() {
 
+#ifndef NO_EVAL_HASH
     ZEROARRAY(mEvalTT);
+#endif
+    ZEROARRAY(mMaterialTT);
 }
 
-void cEngine::EvaluateMaterial(POS *p, eData *e, eColor sd) {
+int cEngine::EvaluateMaterial(POS *p, eColor sd) {
 
     eColor op = ~sd;
 
@@ -49,7 +52,52 @@ void cEngine::EvaluateMaterial(POS *p, eData *e, eColor sd) {
     if (p->mCnt[sd][Q])
         tmp -= V(ELEPH) * (p->mCnt[op][N] + p->mCnt[op][B]);
 
-    Add(e, sd, tmp);
+    return tmp;
+}
+
+// Material terms depend only on piece counts, so they are cached by the
+// material key. Asymmetric bonuses also depend on the side the program plays,
+// which is mixed into the key.
+
+const sMaterialHashEntry *cEngine::ProbeMaterial(POS *p) {
+
+    U64 key = p->mMaterialKey;
+    if (Par.programSide == BC) key ^= SIDE_RANDOM;
+
+    sMaterialHashEntry *entry = &mMaterialTT[key % MATERIAL_HASH_SIZE];
+
+    if (entry->key == key)
+        return entry;
+
+    int mg = EvaluateMaterial(p, WC) - EvaluateMaterial(p, BC);
+    int eg = mg;
+
+    // Asymmetric bonus for keeping certain type of pieces
+
+    eColor sd = Par.programSide;
+    int keep = Par.keep_pc[Q] * p->mCnt[sd][Q]
+             + Par.keep_pc[R] * p->mCnt[sd][R]
+             + Par.keep_pc[B] * p->mCnt[sd][B]
+             + Par.keep_pc[N] * p->mCnt[sd][N]
+             + Par.keep_pc[P] * p->mCnt[sd][P];
+    mg += sd == WC ? keep : -keep;
+
+    // Material imbalance evaluation (based on Crafty)
+
+    int minor_balance = p->mCnt[WC][N] - p->mCnt[BC][N] + p->mCnt[WC][B] - p->mCnt[BC][B];
+    int major_balance = p->mCnt[WC][R] - p->mCnt[BC][R] + 2 * p->mCnt[WC][Q] - 2 * p->mCnt[BC][Q];
+
+    int x = Max(major_balance + 4, 0);
+    if (x > 8) x = 8;
+
+    int y = Max(minor_balance + 4, 0);
+    if (y > 8) y = 8;
+
+    entry->key = key;
+    entry->mg = mg;
+    entry->eg = eg;
+    entry->imbalance = Par.imbalance[x][y];
+    return entry;
 }
 
 void cEngine::EvaluatePieces(POS *p, eData *e, eColor sd) {
@@ -417,6 +465,11 @@ void cEngine::EvaluatePawns(POS *p, eData *e, eColor sd) {
         fl_phalanx = (ShiftSideways(SqBb(sq)) & p->Pawns(sd));
         fl_defended = (SqBb(sq) & e->p_takes[sd]);
 
+        // Passed pawns are scored in EvaluatePassers()
+
+        if (!(Mask.passed[sd][sq] & p->Pawns(op)))
+            e->passers[sd] |= SqBb(sq);
+
         // Candidate passers
 
         if (fl_unopposed) {
@@ -460,48 +513,46 @@ void cEngine::EvaluatePassers(POS *p, eData *e, eColor sd) {
     int mg_tot = 0;
     int eg_tot = 0;
 
-    bb_pieces = p->Pawns(sd);
-    while (bb_pieces) {
-        sq = PopFirstBit(&bb_pieces);
-        bb_pawn = SqBb(sq);
-        bb_stop = BB.ShiftFwd(SqBb(sq), sd);
+    // pawn mobility (stop squares of mobile pawns are empty squares in front of pawns)
 
-        // pawn mobility
+    const int mobile = PopCnt(BB.ShiftFwd(p->Pawns(sd), sd) & ~p->OccBb());
+    const int mobile_center = PopCnt(BB.ShiftFwd(p->Pawns(sd) & Mask.center, sd) & ~p->OccBb());
+    Add(e, sd, V(P_MOB_MG) * mobile, V(P_MOB_EG) * mobile); // pawn mobility bonus
+    Add(e, sd, 2 * mobile_center, 0);                        // additional central pawn mobility bonus
 
-        if (!(bb_stop & p->OccBb())) {
-			Add(e, sd, V(P_MOB_MG), V(P_MOB_EG));        // pawn mobility bonus
-			if (bb_pawn & Mask.center) Add(e, sd, 2, 0); // additional central pawn mobility bonus
+    // TODO: pawn can attack enemy piece in one move
 
-			// TODO: pawn can attack enemy piece in one move
-        }
+    // passed pawns (found by the pawn structure eval, possibly in the pawn hash)
 
-        // passed pawns
+    bb_pieces = e->passers[sd];
+    while (bb_pieces) {
+        sq = PopFirstBit(&bb_pieces);
+        bb_pawn = SqBb(sq);
+        bb_stop = BB.ShiftFwd(SqBb(sq), sd);
 
-        if (!(Mask.passed[sd][sq] & p->Pawns(op))) {
-            mul = 100;
+        mul = 100;
 
-            if (bb_pawn & e->p_takes[sd]) mul += V(P_DEFMUL);
-            if (bb_stop & e->p_takes[sd]) mul += V(P_STOPMUL);
+        if (bb_pawn & e->p_takes[sd]) mul += V(P_DEFMUL);
+        if (bb_stop & e->p_takes[sd]) mul += V(P_STOPMUL);
 
-            if (bb_stop & p->OccBb()) mul -= V(P_BL_MUL);   // blocked passers score less
+        if (bb_stop & p->OccBb()) mul -= V(P_BL_MUL);   // blocked passers score less
 
-            else if ((bb_stop & e->all_att[sd])  // our control of stop square
-                 && (bb_stop & ~e->all_att[op])) mul += V(P_OURSTOP_MUL);
+        else if ((bb_stop & e->all_att[sd])  // our control of stop square
+             && (bb_stop & ~e->all_att[op])) mul += V(P_OURSTOP_MUL);
 
-            else if ((bb_stop & e->all_att[op])  // opp control of stop square
-                 && (bb_stop & ~e->all_att[sd])) mul -= V(P_OPPSTOP_MUL);
+        else if ((bb_stop & e->all_att[op])  // opp control of stop square
+             && (bb_stop & ~e->all_att[sd])) mul -= V(P_OPPSTOP_MUL);
 
-            // in the midgame, we use just a bonus from the table
-            // in the endgame, passed pawn attracts both kings.
+        // in the midgame, we use just a bonus from the table
+        // in the endgame, passed pawn attracts both kings.
 
-            mg_tmp = Par.passed_bonus_mg[sd][Rank(sq)];
-            eg_tmp = Par.passed_bonus_eg[sd][Rank(sq)]
-                     - ((Par.passed_bonus_eg[sd][Rank(sq)] * Dist.bonus[sq][p->mKingSq[op]]) / 30)
-                     + ((Par.passed_bonus_eg[sd][Rank(sq)] * Dist.bonus[sq][p->mKingSq[sd]]) / 90);
+        mg_tmp = Par.passed_bonus_mg[sd][Rank(sq)];
+        eg_tmp = Par.passed_bonus_eg[sd][Rank(sq)]
+                 - ((Par.passed_bonus_eg[sd][Rank(sq)] * Dist.bonus[sq][p->mKingSq[op]]) / 30)
+                 + ((Par.passed_bonus_eg[sd][Rank(sq)] * Dist.bonus[sq][p->mKingSq[sd]]) / 90);
 
-            mg_tot += (mg_tmp * mul) / 100;
-            eg_tot += (eg_tmp * mul) / 100;
-        }
+        mg_tot += (mg_tmp * mul) / 100;
+        eg_tot += (eg_tmp * mul) / 100;
     }
 
     Add(e, sd, (mg_tot * V(W_PASSERS)) / 100, (eg_tot * V(W_PASSERS)) / 100);
@@ -519,18 +570,16 @@ void cEngine::EvaluateUnstoppable(eData *e, POS *p) {
     if (p->mCnt[BC][N] + p->mCnt[BC][B] + p->mCnt[BC][R] + p->mCnt[BC][Q] == 0) {
         king_sq = p->KingSq(BC);
         if (p->mSide == BC) tempo = 1; else tempo = 0;
-        bb_pieces = p->Pawns(WC);
+        bb_pieces = e->passers[WC];
         while (bb_pieces) {
             sq = PopFirstBit(&bb_pieces);
-            if (!(Mask.passed[WC][sq] & p->Pawns(BC))) {
-                bb_span = BB.GetFrontSpan(SqBb(sq), WC);
-                pawn_sq = ((WC - 1) & 56) + (sq & 7);
-                prom_dist = Min(5, Dist.metric[sq][pawn_sq]);
-
-                if (prom_dist < (Dist.metric[king_sq][pawn_sq] - tempo)) {
-                    if (bb_span & p->Kings(WC)) prom_dist++;
-                    w_dist = Min(w_dist, prom_dist);
-                }
+            bb_span = BB.GetFrontSpan(SqBb(sq), WC);
+            pawn_sq = ((WC - 1) & 56) + (sq & 7);
+            prom_dist = Min(5, Dist.metric[sq][pawn_sq]);
+
+            if (prom_dist < (Dist.metric[king_sq][pawn_sq] - tempo)) {
+                if (bb_span & p->Kings(WC)) prom_dist++;
+                w_dist = Min(w_dist, prom_dist);
             }
         }
     }
@@ -540,18 +589,16 @@ void cEngine::EvaluateUnstoppable(eData *e, POS *p) {
     if (p->mCnt[WC][N] + p->mCnt[WC][B] + p->mCnt[WC][R] + p->mCnt[WC][Q] == 0) {
         king_sq = p->KingSq(WC);
         if (p->mSide == WC) tempo = 1; else tempo = 0;
-        bb_pieces = p->Pawns(BC);
+        bb_pieces = e->passers[BC];
         while (bb_pieces) {
             sq = PopFirstBit(&bb_pieces);
-            if (!(Mask.passed[BC][sq] & p->Pawns(WC))) {
-                bb_span = BB.GetFrontSpan(SqBb(sq), BC);
-                pawn_sq = ((BC - 1) & 56) + (sq & 7);
-                prom_dist = Min(5, Dist.metric[sq][pawn_sq]);
-
-                if (prom_dist < (Dist.metric[king_sq][pawn_sq] - tempo)) {
-                    if (bb_span & p->Kings(BC)) prom_dist++;
-                    b_dist = Min(b_dist, prom_dist);
-                }
+            bb_span = BB.GetFrontSpan(SqBb(sq), BC);
+            pawn_sq = ((BC - 1) & 56) + (sq & 7);
+            prom_dist = Min(5, Dist.metric[sq][pawn_sq]);
+
+            if (prom_dist < (Dist.metric[king_sq][pawn_sq] - tempo)) {
+                if (bb_span & p->Kings(BC)) prom_dist++;
+                b_dist = Min(b_dist, prom_dist);
             }
         }
     }
@@ -649,6 +696,8 @@ void cEngine::EvaluateThreats(POS *p, eData *e, eColor sd) {
 
 int cEngine::Evaluate(POS *p, eData *e) {
 
+#ifndef NO_EVAL_HASH
+
     // Try retrieving score from per-thread eval hashtable
 
     int addr = p->mHashKey % EVAL_HASH_SIZE;
@@ -657,6 +706,7 @@ int cEngine::Evaluate(POS *p, eData *e) {
         int sc = mEvalTT[addr].score;
         return p->mSide == WC ? sc : -sc;
     }
+#endif
 
     // Clear eval data
 
@@ -667,14 +717,12 @@ int cEngine::Evaluate(POS *p, eData *e) {
 	e->att[WC] = e->att[BC] = 0;
 	e->wood[WC] = e->wood[BC] = 0;
 
-    // Init helper bitboards (pawn info)
+    // Evaluate pawn structure (usually a pawn hash hit) and set up
+    // helper bitboards (pawn info) that the other subroutines need
 
-    e->p_takes[WC] = GetWPControl(p->Pawns(WC));
-    e->p_takes[BC] = GetBPControl(p->Pawns(BC));
+    EvaluatePawnStruct(p, e);
     e->p_can_take[WC] = BB.FillNorth(e->p_takes[WC]);
     e->p_can_take[BC] = BB.FillSouth(e->p_takes[BC]);
-    e->two_pawns_take[WC] = GetDoubleWPControl(p->Pawns(WC));
-    e->two_pawns_take[BC] = GetDoubleBPControl(p->Pawns(BC));
 
     // Init or clear attack maps
 
@@ -685,11 +733,8 @@ int cEngine::Evaluate(POS *p, eData *e) {
 
     // Run all the evaluation subroutines
 
-    EvaluateMaterial(p, e, WC);
-    EvaluateMaterial(p, e, BC);
     EvaluatePieces(p, e, WC);
     EvaluatePieces(p, e, BC);
-    EvaluatePawnStruct(p, e);
     EvaluatePassers(p, e, WC);
     EvaluatePassers(p, e, BC);
     EvaluateUnstoppable(e, p);
@@ -714,30 +759,15 @@ int cEngine::Evaluate(POS *p, eData *e) {
     e->eg[WC] += e->eg_pawns[WC];
     e->eg[BC] += e->eg_pawns[BC];
 
-    // Add asymmetric bonus for keeping certain type of pieces
+    // Add material adjustments, asymmetric bonuses and imbalance (usually a material hash hit)
 
-    e->mg[Par.programSide] += Par.keep_pc[Q] * p->mCnt[Par.programSide][Q];
-    e->mg[Par.programSide] += Par.keep_pc[R] * p->mCnt[Par.programSide][R];
-    e->mg[Par.programSide] += Par.keep_pc[B] * p->mCnt[Par.programSide][B];
-    e->mg[Par.programSide] += Par.keep_pc[N] * p->mCnt[Par.programSide][N];
-    e->mg[Par.programSide] += Par.keep_pc[P] * p->mCnt[Par.programSide][P];
+    const sMaterialHashEntry *mat = ProbeMaterial(p);
+    e->mg[WC] += mat->mg;
+    e->eg[WC] += mat->eg;
 
     // Interpolate between midgame and endgame scores
 
-    int score = Interpolate(p, e);
-
-    // Material imbalance evaluation (based on Crafty)
-
-    int minor_balance = p->mCnt[WC][N] - p->mCnt[BC][N] + p->mCnt[WC][B] - p->mCnt[BC][B];
-    int major_balance = p->mCnt[WC][R] - p->mCnt[BC][R] + 2 * p->mCnt[WC][Q] - 2 * p->mCnt[BC][Q];
-
-    int x = Max(major_balance + 4, 0);
-    if (x > 8) x = 8;
-
-    int y = Max(minor_balance + 4, 0);
-    if (y > 8) y = 8;
-
-    score += Par.imbalance[x][y];
+    int score = Interpolate(p, e) + mat->imbalance;
 
     // Weakening: add pseudo-random value to eval score
 
@@ -762,10 +792,13 @@ int cEngine::Evaluate(POS *p, eData *e) {
 
     score = Clip(score, MAX_EVAL);
 
+#ifndef NO_EVAL_HASH
+
     // Save eval score in the evaluation hash table
 
     mEvalTT[addr].key = p->mHashKey;
     mEvalTT[addr].score = score;
+#endif
 
     // Return score relative to the side to move
 
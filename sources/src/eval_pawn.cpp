@@ -19,23 +19,85 @@ If not, see <http://www.gnu.org/licenses/>.
 #include "eval.h"
 #include <cstring>
 
-void cEngine::ClearPawnHash() {
+cPawnHash PawnHash;
 
-    ZEROARRAY(mPawnTT);
+void cPawnHash::Alloc(int mbsize) {
+
+    U64 entries = 1;
+    while (entries * 2 * sizeof(sPawnHashEntry) <= (U64)mbsize * 1024 * 1024)
+        entries *= 2;
+
+    if (mTable == NULL || entries != mMask + 1) { // don't waste time if the size is the same
+
+        void *mem = malloc(entries * sizeof(sPawnHashEntry) + 64);
+
+        if (mem == NULL) { // keep the current table
+            printf("info string pawn hash allocation error\n");
+            return;
+        }
+
+        free(mMem);
+        mMem = mem;
+        mTable = (sPawnHashEntry *)(((uintptr_t)mMem + 63) & ~(uintptr_t)63);
+        mMask = entries - 1;
+    }
+
+    Clear();
 }
 
-void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
+void cPawnHash::Clear() {
+
+    memset((void *)mTable, 0, (mMask + 1) * sizeof(sPawnHashEntry));
+}
+
+// Fills the pawn scores (as a white-black delta in mg_pawns[WC], eg_pawns[WC])
+// and the pawn bitboards of eData on a hit
+
+bool cPawnHash::Retrieve(U64 key, eData *e) const {
+
+    const sPawnHashEntry *entry = mTable + (key & mMask);
+    const U64 data = entry->data.load(std::memory_order_relaxed);
+    U64 check = entry->check.load(std::memory_order_relaxed) ^ data;
+
+    for (int sd = WC; sd <= BC; sd++) {
+        e->p_takes[sd] = entry->p_takes[sd].load(std::memory_order_relaxed);
+        e->two_pawns_take[sd] = entry->two_pawns_take[sd].load(std::memory_order_relaxed);
+        e->passers[sd] = entry->passers[sd].load(std::memory_order_relaxed);
+        check ^= e->p_takes[sd] ^ e->two_pawns_take[sd] ^ e->passers[sd];
+    }
+
+    if (check != key)
+        return false;
+
+    e->mg_pawns[WC] = (int32_t)(data & 0xFFFFFFFF);
+    e->eg_pawns[WC] = (int32_t)(data >> 32);
+    return true;
+}
 
-    // Try to retrieve score from pawn hashtable
+void cPawnHash::Store(U64 key, const eData *e, int mg, int eg) {
 
-    int addr = p->mPawnKey % PAWN_HASH_SIZE;
+    sPawnHashEntry *entry = mTable + (key & mMask);
+    const U64 data = (U64)(uint32_t)mg | (U64)(uint32_t)eg << 32;
+    U64 check = key ^ data;
 
-    if (mPawnTT[addr].key == p->mPawnKey) {
+    entry->data.store(data, std::memory_order_relaxed);
+    for (int sd = WC; sd <= BC; sd++) {
+        entry->p_takes[sd].store(e->p_takes[sd], std::memory_order_relaxed);
+        entry->two_pawns_take[sd].store(e->two_pawns_take[sd], std::memory_order_relaxed);
+        entry->passers[sd].store(e->passers[sd], std::memory_order_relaxed);
+        check ^= e->p_takes[sd] ^ e->two_pawns_take[sd] ^ e->passers[sd];
+    }
+    entry->check.store(check, std::memory_order_relaxed);
+}
+
+void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
+
+    // Try to retrieve score and pawn bitboards from pawn hashtable
+
+    if (PawnHash.Retrieve(p->mPawnKey, e)) {
 
         // pawn hashtable contains delta of white and black score
 
-        e->mg_pawns[WC] = mPawnTT[addr].mg_pawns;
-        e->eg_pawns[WC] = mPawnTT[addr].eg_pawns;
         e->mg_pawns[BC] = 0;
         e->eg_pawns[BC] = 0;
         return;
@@ -47,6 +109,15 @@ void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
     e->mg_pawns[BC] = 0;
     e->eg_pawns[WC] = 0;
     e->eg_pawns[BC] = 0;
+    e->passers[WC] = 0;
+    e->passers[BC] = 0;
+
+    // Helper bitboards (pawn info)
+
+    e->p_takes[WC] = GetWPControl(p->Pawns(WC));
+    e->p_takes[BC] = GetBPControl(p->Pawns(BC));
+    e->two_pawns_take[WC] = GetDoubleWPControl(p->Pawns(WC));
+    e->two_pawns_take[BC] = GetDoubleBPControl(p->Pawns(BC));
 
     // Pawn structure
 
@@ -117,10 +188,15 @@ void cEngine::EvaluatePawnStruct(POS *p, eData *e) {
     // Save stuff in pawn hashtable.
     // Note that we save delta between white and black scores.
     // It might become a problem if we decide to print detailed eval score.
+    // The weighted delta is also what we return, so that the score doesn't
+    // depend on whether the pawn hash was hit.
+
+    e->mg_pawns[WC] = (V(W_STRUCT) * (e->mg_pawns[WC] - e->mg_pawns[BC])) / 100;
+    e->eg_pawns[WC] = (V(W_STRUCT) * (e->eg_pawns[WC] - e->eg_pawns[BC])) / 100;
+    e->mg_pawns[BC] = 0;
+    e->eg_pawns[BC] = 0;
 
-    mPawnTT[addr].key = p->mPawnKey;
-    mPawnTT[addr].mg_pawns = (V(W_STRUCT) * (e->mg_pawns[WC] - e->mg_pawns[BC])) / 100;
-    mPawnTT[addr].eg_pawns = (V(W_STRUCT) * (e->eg_pawns[WC] - e->eg_pawns[BC])) / 100;
+    PawnHash.Store(p->mPawnKey, e, e->mg_pawns[WC], e->eg_pawns[WC]);
 }
 
 void cEngine::EvaluateKing(POS *p, eData *e, eColor sd) {
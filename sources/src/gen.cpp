@@ -282,20 +282,20 @@ int *POS::GenerateQuiet(int *list) const {
     return list;
 }
 
-int *POS::GenerateSpecial(int *list) const {
+int *POS::GenerateSpecial(int *list) {
 
     U64 bb_pieces, bb_moves;
     int from, to;
     eColor sd = mSide;
-    eColor op = ~sd;
+
+    if (!mCheck.ready) CompleteCheckInfo();
 
     // squares from which normal (non-discovered) checks are possible
 
-    int king_sq = KingSq(op);
-    U64 n_check = BB.KnightAttacks(king_sq);
-    U64 r_check = BB.RookAttacks(OccBb(), king_sq);
-    U64 b_check = BB.BishAttacks(OccBb(), king_sq);
-    U64 p_check = BB.ShiftFwd(ShiftSideways(SqBb(king_sq)), op);
+    U64 n_check = mCheck.checkSq[N];
+    U64 r_check = mCheck.checkSq[R];
+    U64 b_check = mCheck.checkSq[B];
+    U64 p_check = mCheck.checkSq[P];
 
     // TODO: discovered checks by a pawn
 
@@ -330,19 +330,15 @@ int *POS::GenerateSpecial(int *list) const {
         }
     }
 
+    // pieces that can give a discovered check may go anywhere
+
     // KNIGHT
 
     bb_pieces = Knights(sd);
     while (bb_pieces) {
         from = PopFirstBit(&bb_pieces);
-
-        // are discovered checks possible?
-
-        U64 bb_checkers = Queens(sd) | Rooks(sd) | Bishops(sd);
-        bool knight_discovers = CanDiscoverCheck(bb_checkers, op, from);
-
         bb_moves = BB.KnightAttacks(from) & UnoccBb();
-        if (!knight_discovers) bb_moves = bb_moves & n_check;
+        if (!(mCheck.discoverers & SqBb(from))) bb_moves = bb_moves & n_check;
         while (bb_moves) {
             to = PopFirstBit(&bb_moves);
             *list++ = (to << 6) | from;
@@ -354,13 +350,8 @@ int *POS::GenerateSpecial(int *list) const {
     bb_pieces = Bishops(sd);
     while (bb_pieces) {
         from = PopFirstBit(&bb_pieces);
-
-        // are straight discovered checks possible?
-
-        bool bish_discovers = CanDiscoverCheck(StraightMovers(sd), op, from);
-
         bb_moves = BB.BishAttacks(OccBb(), from) & UnoccBb();
-        if (!bish_discovers) bb_moves = bb_moves & b_check;
+        if (!(mCheck.discoverers & SqBb(from))) bb_moves = bb_moves & b_check;
         while (bb_moves) {
             to = PopFirstBit(&bb_moves);
             *list++ = (to << 6) | from;
@@ -372,13 +363,8 @@ int *POS::GenerateSpecial(int *list) const {
     bb_pieces = Rooks(sd);
     while (bb_pieces) {
         from = PopFirstBit(&bb_pieces);
-
-        // are diagonal discovered checks possible?
-
-        bool rook_discovers = CanDiscoverCheck(DiagMovers(sd), op, from);
-
         bb_moves = BB.RookAttacks(OccBb(), from) & UnoccBb();
-        if (!rook_discovers) bb_moves = bb_moves & r_check;
+        if (!(mCheck.discoverers & SqBb(from))) bb_moves = bb_moves & r_check;
         while (bb_moves) {
             to = PopFirstBit(&bb_moves);
             *list++ = (to << 6) | from;
@@ -391,7 +377,7 @@ int *POS::GenerateSpecial(int *list) const {
     while (bb_pieces) {
         from = PopFirstBit(&bb_pieces);
         bb_moves = BB.QueenAttacks(OccBb(), from) & UnoccBb();
-        bb_moves = bb_moves & (r_check | b_check);
+        if (!(mCheck.discoverers & SqBb(from))) bb_moves = bb_moves & (r_check | b_check);
         while (bb_moves) {
             to = PopFirstBit(&bb_moves);
             *list++ = (to << 6) | from;
@@ -410,18 +396,3 @@ int *POS::GenerateSpecial(int *list) const {
     */
     return list;
 }
-
-bool POS::CanDiscoverCheck(U64 bb_checkers, eColor op, int from) const {
-
-    while (bb_checkers) {
-        int checker = PopFirstBit(&bb_checkers);
-        U64 bb_ray = BB.bbBetween[checker][mKingSq[op]];
-
-        if (SqBb(from) & bb_ray) {
-            if (PopCnt(bb_ray & OccBb()) == 1)
-                return true;
-        }
-    }
-
-    return false;
-}
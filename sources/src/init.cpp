@@ -50,4 +50,8 @@ void POS::Init() { // static init function
 
     for (int i = 0; i < 8; i++)
         msZobEp[i] = Random64();
+
+    for (int i = 0; i < 12; i++)
+        for (int j = 0; j < 16; j++)
+            msZobMaterial[i][j] = Random64();
 }
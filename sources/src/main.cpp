@@ -24,6 +24,30 @@ cGlobals Glob;
 #ifdef USE_THREADS
     #include <list>
     std::list<cEngine> Engines(1);
+
+    // The Threads option goes up to the number of hardware threads, but never
+    // below 128, so that setups for big machines can be run (oversubscribed)
+    // and tested anywhere.
+
+    int MaxThreads() {
+        return Max(128, (int)std::thread::hardware_concurrency());
+    }
+
+    // Rebuilds the engine list, and with it the worker threads, when the
+    // number of search threads changes.
+
+    void SetThreads(int count) {
+
+        Glob.thread_no = Min(Max(count, 1), MaxThreads());
+
+        if (Glob.thread_no != (int)Engines.size()) {
+            Engines.clear();
+            for (int i = 0; i < Glob.thread_no; i++)
+                Engines.emplace_back(i);
+            if (Glob.thread_binding != BIND_NONE)
+                BindThreads();
+        }
+    }
 #else
     cEngine EngineSingle(0);
 #endif
@@ -137,6 +161,7 @@ void cGlobals::Init() {
     use_books_from_pers = true;
     show_pers_file = true;
     thread_no = 1;
+    thread_binding = BIND_NONE;
 	if (Glob.threadOverride)
 		thread_no = Glob.threadOverride;
 	time_buffer = 10; // blitz under Arena would require something like 200, but it's user's job
@@ -148,6 +173,9 @@ void cGlobals::Init() {
     // of threads for testing purposes
 
 #ifdef USE_THREADS
+    if (thread_no > MaxThreads())
+        thread_no = MaxThreads();
+
     if (thread_no > 1) { //-V547 get rid of PVS Studio warning
         Engines.clear();
         for (int i = 0; i < thread_no; i++)
@@ -26,6 +26,12 @@ void POS::DoMove(int move, UNDO *u) {
     int ftp = Tp(mPc[fsq]); // moving piece
     int ttp = Tp(mPc[tsq]); // captured piece
 
+    // Check information for the position after the move. Without check, king move,
+    // pin or en passant capture the move can't leave the own king in check.
+
+    const bool check = GivesCheck(move); // completes mCheck
+    const bool safe = !mCheck.checkers && ftp != K && MoveType(move) != EP_CAP && !(mCheck.pinned & SqBb(fsq));
+
     // Save data for undoing a move
 
     if (u) {
@@ -35,6 +41,8 @@ void POS::DoMove(int move, UNDO *u) {
         u->mRevMovesUd = mRevMoves;
         u->mHashKeyUd  = mHashKey;
         u->mPawnKeyUd  = mPawnKey;
+        u->mMaterialKeyUd = mMaterialKey;
+        u->mCheckUd    = mCheck;
     }
 
     // Update reversible moves counter
@@ -90,6 +98,7 @@ void POS::DoMove(int move, UNDO *u) {
         mEgSc[op] -= Par.eg_pst[op][ttp][tsq];
         mPhase -= ph_value[ttp];
         mCnt[op][ttp]--; // piece count
+        mMaterialKey ^= msZobMaterial[Pc(op, ttp)][mCnt[op][ttp]];
     }
 
     switch (MoveType(move)) {
@@ -131,6 +140,7 @@ void POS::DoMove(int move, UNDO *u) {
             mEgSc[op] -= Par.eg_pst[op][P][tsq];
             mPhase -= ph_value[P];
             mCnt[op][P]--;
+            mMaterialKey ^= msZobMaterial[Pc(op, P)][mCnt[op][P]];
             break;
 
         // Double pawn move
@@ -156,6 +166,7 @@ void POS::DoMove(int move, UNDO *u) {
             mEgSc[sd] += Par.eg_pst[sd][ftp][tsq] - Par.eg_pst[sd][P][tsq];
             mPhase += ph_value[ftp] - ph_value[P];
             mCnt[sd][P]--;
+            mMaterialKey ^= msZobMaterial[Pc(sd, P)][mCnt[sd][P]] ^ msZobMaterial[Pc(sd, ftp)][mCnt[sd][ftp]];
             mCnt[sd][ftp]++;
             break;
     }
@@ -164,12 +175,77 @@ void POS::DoMove(int move, UNDO *u) {
 
 	mSide = ~mSide;
     mHashKey ^= SIDE_RANDOM;
+
+    InitCheckInfo(check);
+    mCheck.moverSafe = safe;
+}
+
+// Hash and pawn keys of the position after the move, computed without making
+// it, so that the search can prefetch hash entries before calling DoMove()
+
+U64 POS::KeyAfter(int move, U64 *pawn_key) const {
+
+    eColor sd = mSide;
+    eColor op = ~sd;
+    int fsq = Fsq(move);
+    int tsq = Tsq(move);
+    int ftp = Tp(mPc[fsq]);
+    int ttp = Tp(mPc[tsq]);
+    U64 key = mHashKey ^ SIDE_RANDOM;
+
+    *pawn_key = mPawnKey;
+
+    if (ftp == P || ftp == K)
+        *pawn_key ^= msZobPiece[Pc(sd, ftp)][fsq] ^ msZobPiece[Pc(sd, ftp)][tsq];
+
+    key ^= msZobCastle[mCFlags] ^ msZobCastle[mCFlags & msCastleMask[fsq] & msCastleMask[tsq]];
+    if (mEpSq != NO_SQ)
+        key ^= msZobEp[File(mEpSq)];
+    key ^= msZobPiece[Pc(sd, ftp)][fsq] ^ msZobPiece[Pc(sd, ftp)][tsq];
+
+    if (ttp != NO_TP) {
+        key ^= msZobPiece[Pc(op, ttp)][tsq];
+        if (ttp == P)
+            *pawn_key ^= msZobPiece[Pc(op, ttp)][tsq];
+    }
+
+    switch (MoveType(move)) {
+        case NORMAL:
+            break;
+
+        case CASTLE:
+            switch (tsq) {
+                case C1: key ^= msZobPiece[Pc(sd, R)][A1] ^ msZobPiece[Pc(sd, R)][D1]; break;
+                case G1: key ^= msZobPiece[Pc(sd, R)][H1] ^ msZobPiece[Pc(sd, R)][F1]; break;
+                case C8: key ^= msZobPiece[Pc(sd, R)][A8] ^ msZobPiece[Pc(sd, R)][D8]; break;
+                case G8: key ^= msZobPiece[Pc(sd, R)][H8] ^ msZobPiece[Pc(sd, R)][F8]; break;
+            }
+            break;
+
+        case EP_CAP:
+            key ^= msZobPiece[Pc(op, P)][tsq ^ 8];
+            *pawn_key ^= msZobPiece[Pc(op, P)][tsq ^ 8];
+            break;
+
+        case EP_SET:
+            if (BB.PawnAttacks(sd, tsq ^ 8) & Pawns(op))
+                key ^= msZobEp[File(tsq ^ 8)];
+            break;
+
+        case N_PROM: case B_PROM: case R_PROM: case Q_PROM:
+            key ^= msZobPiece[Pc(sd, P)][tsq] ^ msZobPiece[Pc(sd, PromType(move))][tsq];
+            *pawn_key ^= msZobPiece[Pc(sd, P)][tsq];
+            break;
+    }
+
+    return key;
 }
 
 void POS::DoNull(UNDO *u) {
 
     u->mEpSqUd    = mEpSq;
     u->mHashKeyUd = mHashKey;
+    u->mCheckUd   = mCheck;
     mRepList[mHead++] = mHashKey;
     mRevMoves++;
     if (mEpSq != NO_SQ) {
@@ -178,4 +254,5 @@ void POS::DoNull(UNDO *u) {
     }
 	mSide = ~mSide;
     mHashKey ^= SIDE_RANDOM;
+    InitCheckInfo();
 }
@@ -31,6 +31,8 @@ void POS::UndoMove(int move, UNDO *u) {
     mRevMoves = u->mRevMovesUd;
     mHashKey  = u->mHashKeyUd;
     mPawnKey  = u->mPawnKeyUd;
+    mMaterialKey = u->mMaterialKeyUd;
+    mCheck    = u->mCheckUd;
 
     mHead--;
 
@@ -114,6 +116,7 @@ void POS::UndoNull(UNDO *u) {
 
     mEpSq    = u->mEpSqUd;
     mHashKey = u->mHashKeyUd;
+    mCheck   = u->mCheckUd;
     mHead--;
     mRevMoves--;
     mSide = ~mSide;
@@ -200,7 +200,8 @@ int cEngine::NextSpecialMove(MOVES *m, int *flag) {
                 move = SelectBest(m);
                 if (move == m->trans_move
                 ||  move == m->killer1
-                ||  move == m->killer2)
+                ||  move == m->killer2
+                || !m->p->GivesCheck(move)) // a discovering piece may stay on the line
                     continue;
                 *flag = MV_NORMAL;
                 return move;
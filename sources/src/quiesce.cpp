@@ -25,11 +25,12 @@ If not, see <http://www.gnu.org/licenses/>.
 int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     int best, score, move, new_pv[MAX_PLY];
-    int mv_type, hashFlag;
+    int mv_type;
     bool is_pv = (alpha != beta - 1);
     MOVES m[1];
     UNDO u[1];
     eData e;
+    sHashEntry hash;
 
     if (p->InCheck()) {
         return QuiesceFlee(p, ply, alpha, beta, pv);
@@ -37,7 +38,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    IncNodes();
     Slowdown();
     
     if (Glob.abortSearch && mRootDepth > 1) {
@@ -50,11 +51,10 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
         return p->DrawScore();
     }
 
-    move = 0;
-
     // DETERMINE FLOOR VALUE
 
-    best = Evaluate(p, &e);
+    int eval = Evaluate(p, &e);
+    best = eval;
 
     if (best >= beta) {
         return best;
@@ -65,15 +65,20 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
     }
 
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
+    // (probing after the stand pat test saves more table traffic
+    // than taking the eval from the entry would save evaluations)
 
-    if (Trans.Retrieve(p->mHashKey, &move, &score, &hashFlag, alpha, beta, 0, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hash);
+    move = hash.move;
+
+    if (hash.Cuts(alpha, beta, 0)) {
         
-        if (score >= beta) {
+        if (hash.score >= beta) {
             UpdateHistory(p, -1, move, 1, ply);
         }
 
         if (!is_pv) {
-            return score; // !is_pv condition confirmed 2018-08-13
+            return hash.score; // !is_pv condition confirmed 2018-08-13
         }
     }
 
@@ -93,6 +98,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
         // MAKE MOVE
 
+        PrefetchMove(p, move);
         p->DoMove(move, u);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
@@ -111,7 +117,7 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
         // BETA CUTOFF
 
         if (score >= beta) {
-            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply);
+            StoreHash(p->mHashKey, move, score, eval, LOWER, 0, ply);
             return score;
         }
 
@@ -135,8 +141,8 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply);
-    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply);
+    if (*pv) StoreHash(p->mHashKey, *pv, best, eval, EXACT, 0, ply);
+    else     StoreHash(p->mHashKey,   0, best, eval, UPPER, 0, ply);
 
     return best;
 }
@@ -144,15 +150,16 @@ int cEngine::QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv) {
 int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
     int best, score, move, new_pv[MAX_PLY];
-    int mv_type, hashFlag;
+    int mv_type;
     bool is_pv = (alpha != beta - 1);
     MOVES m[1];
     UNDO u[1];
     eData e;
+    sHashEntry hash;
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    IncNodes();
     Slowdown();
     
     if (Glob.abortSearch && mRootDepth > 1) {
@@ -165,18 +172,19 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
         return p->DrawScore();
     }
     
-    move = 0;
-
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (Trans.Retrieve(p->mHashKey, &move, &score, &hashFlag, alpha, beta, 0, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hash);
+    move = hash.move;
+
+    if (hash.Cuts(alpha, beta, 0)) {
         
-        if (score >= beta) {
+        if (hash.score >= beta) {
             UpdateHistory(p, -1, move, 1, ply);
         }
 
         if (!is_pv) {
-            return score;
+            return hash.score;
         }
     }
 
@@ -197,6 +205,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
         // MAKE MOVE
 
+        PrefetchMove(p, move);
         p->DoMove(move, u);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
@@ -215,7 +224,7 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
         // BETA CUTOFF
 
         if (score >= beta) {
-            Trans.Store(p->mHashKey, move, score, LOWER, 0, ply);
+            StoreHash(p->mHashKey, move, score, NO_EVAL, LOWER, 0, ply);
             return score;
         }
 
@@ -238,8 +247,8 @@ int cEngine::QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv) {
 
     // SAVE RESULT IN THE TRANSPOSITION TABLE
 
-    if (*pv) Trans.Store(p->mHashKey, *pv, best, EXACT, 0, ply);
-    else     Trans.Store(p->mHashKey,   0, best, UPPER, 0, ply);
+    if (*pv) StoreHash(p->mHashKey, *pv, best, NO_EVAL, EXACT, 0, ply);
+    else     StoreHash(p->mHashKey,   0, best, NO_EVAL, UPPER, 0, ply);
 
     return best;
 }
@@ -258,7 +267,7 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
         return QuiesceFlee(p, ply, alpha, beta, pv);
     }
 
-    Glob.nodes++;
+    IncNodes();
     Slowdown();
 
     // EARLY EXIT
@@ -322,6 +331,7 @@ int cEngine::Quiesce(POS *p, int ply, int alpha, int beta, int *pv) {
 
         // MAKE MOVE
 
+        PrefetchMove(p, move);
         p->DoMove(move, u);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
@@ -41,6 +41,8 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdint>
 #include <cinttypes>
+#include <cstdlib>
+#include <atomic>
 
 //#define USE_TUNING
 
@@ -48,7 +50,9 @@ using U64 = uint64_t;
 
 // max size of hashtable
 
-#ifdef _WIN64
+#if defined(__linux__) && UINTPTR_MAX > 0xFFFFFFFFu
+static constexpr int max_tt_size_mb = 1 << 20; // 1TB, the table is one allocation indexed by 64-bit numbers
+#elif defined(_WIN64)
 static constexpr int max_tt_size_mb = 16384;
 #else
 static constexpr int max_tt_size_mb = 4096; // TODO: Fruit 3.2.1 uses 16384 on 64-bit systems, 1024 otherwise
@@ -72,10 +76,12 @@ static constexpr int max_tt_size_mb = 4096; // TODO: Fruit 3.2.1 uses 16384 on 6
 
 #ifndef NO_THREADS
     #include <thread>
+    #include <mutex>
+    #include <condition_variable>
+    #include <functional>
     #ifndef USE_THREADS
        #define USE_THREADS
     #endif
-    #define MAX_THREADS 48
 #else
     #undef USE_THREADS
 #endif
@@ -89,6 +95,7 @@ enum eCastleFlag { W_KS = 1, W_QS = 2, B_KS = 4, B_QS = 8 };
 enum eMoveType   { NORMAL, CASTLE, EP_CAP, EP_SET, N_PROM, B_PROM, R_PROM, Q_PROM };
 enum eMoveFlag   { MV_NORMAL, MV_HASH, MV_CAPTURE, MV_REFUTATION, MV_KILLER, MV_BADCAPT };
 enum eHashType   { NONE, UPPER, LOWER, EXACT };
+enum eHashStore  { STORE_SAME, STORE_EMPTY, STORE_OLD, STORE_LIVE, STORE_NONE, STORE_RESULTS }; // what a TT store overwrote
 enum eSquare {
     A1, B1, C1, D1, E1, F1, G1, H1,
     A2, B2, C2, D2, E2, F2, G2, H2,
@@ -115,11 +122,13 @@ constexpr int DEF_EG = R;
 
 constexpr int MAX_PLY   = 64;
 constexpr int MAX_MOVES = 256;
+constexpr int MAX_DEFERRED = 32;
 constexpr int INF       = 32767;
 constexpr int MATE      = 32000;
 constexpr int MAX_EVAL  = 29999;
+constexpr int NO_EVAL   = -INF;   // static eval of a node in check, or not known
 constexpr int MAX_HIST  = 1 << 15;
-constexpr int MAX_PV    = 12;
+constexpr int MAX_PV    = MAX_MOVES;
 
 constexpr U64 RANK_1_BB = 0x00000000000000FF;
 constexpr U64 RANK_2_BB = 0x000000000000FF00;
@@ -200,6 +209,13 @@ template<typename T> constexpr T Clip(const T& sc, const T& lim) { if (sc < -lim
     #endif
 #endif
 
+#if defined(_MSC_VER)
+    #include <xmmintrin.h>
+    #define PREFETCH(addr) _mm_prefetch((const char *)(addr), _MM_HINT_T0)
+#else
+    #define PREFETCH(addr) __builtin_prefetch(addr)
+#endif
+
 // Compiler and architecture dependent versions of FirstOne() function,
 // triggered by defines at the top of this file.
 #ifdef USE_FIRST_ONE_INTRINSICS
@@ -300,6 +316,8 @@ class cBitBoard {
 
   public:
     U64 bbBetween[64][64];
+    U64 bbRookPseudo[64];     // rook and bishop attacks on an empty board
+    U64 bbBishPseudo[64];
     void Init();
     void Print(U64 bb);
     U64 ShiftFwd(U64 bb, eColor sd);
@@ -320,6 +338,15 @@ class cBitBoard {
 
 extern cBitBoard BB;
 
+struct sCheckInfo {            // kept up to date by POS::DoMove(), for the side to move
+    U64 checkers;             // enemy pieces giving check
+    U64 pinned;               // own pieces pinned to the king
+    U64 discoverers;          // own pieces that uncover a check by an own slider when moving off its line
+    U64 checkSq[6];           // by piece type: squares from which an own piece would check the enemy king
+    bool ready;               // pinned, discoverers and checkSq are valid, see POS::CompleteCheckInfo()
+    bool moverSafe;           // the move that led here is known not to leave its side in check
+};
+
 struct UNDO {
     int mTtpUd;
     int mCFlagsUd;
@@ -327,6 +354,8 @@ struct UNDO {
     int mRevMovesUd;
     U64 mHashKeyUd;
     U64 mPawnKeyUd;
+    U64 mMaterialKeyUd;
+    sCheckInfo mCheckUd;
 };
 
 class POS {
@@ -334,16 +363,19 @@ class POS {
     static U64 msZobPiece[12][64];
     static U64 msZobCastle[16];
     static U64 msZobEp[8];
+    static U64 msZobMaterial[12][16];   // indexed by piece and by how many of them came before
 
     void ClearPosition();
     void InitHashKey();
     void InitPawnKey();
+    void InitMaterialKey();
+    void InitCheckInfo(bool maybe_check = true);
+    void CompleteCheckInfo();
 
     U64 AttacksFrom(int sq) const;
     U64 AttacksTo(int sq) const;
     bool Attacked(int sq, eColor sd) const;
-
-    bool CanDiscoverCheck(U64 bb_checkers, eColor op, int from) const; // for GenerateSpecial()
+    U64 Blockers(int ksq, eColor sd) const;
 
   public:
     U64 mClBb[2];
@@ -361,6 +393,8 @@ class POS {
     int mHead;
     U64 mHashKey;
     U64 mPawnKey;
+    U64 mMaterialKey;
+    sCheckInfo mCheck;
     U64 mRepList[256];
 
     NOINLINE static U64 Random64();
@@ -387,10 +421,12 @@ class POS {
     bool MayNull() const { return (mClBb[mSide] & ~(mTpBb[P] | mTpBb[K])) != 0; }
     bool IsOnSq(eColor sd, int tp, int sq) const { return PcBb(sd, tp) & SqBb(sq); }
 
-    bool InCheck() const { return Attacked(KingSq(mSide), ~mSide); }
-    bool Illegal() const { return Attacked(KingSq(~mSide), mSide); }
+    bool InCheck() const { return mCheck.checkers != 0; }
+    bool Illegal() const { return !mCheck.moverSafe && Attacked(KingSq(~mSide), mSide); }
+    bool GivesCheck(int move);
 
     void DoMove(int move, UNDO *u = nullptr);
+    U64 KeyAfter(int move, U64 *pawn_key) const;
     void DoNull(UNDO *u);
     void UndoNull(UNDO *u);
     void UndoMove(int move, UNDO *u);
@@ -409,7 +445,7 @@ class POS {
 
     int *GenerateCaptures(int *list) const;
     int *GenerateQuiet(int *list) const;
-    int *GenerateSpecial(int *list) const;
+    int *GenerateSpecial(int *list);
 
     int Swap(int from, int to);
 
@@ -432,13 +468,23 @@ struct MOVES {
     int bad[MAX_MOVES];
 };
 
-struct ENTRY {
-    U64 key;
-    int16_t date;
-    int16_t move;
-    int16_t score;
-    uint8_t flags;
-    uint8_t depth;
+struct alignas(64) sTTCluster { // one cache line of transposition table entries
+    std::atomic<uint16_t> key[6]; // lower 16 bits of the hash keys, xor-ed with a check of the data and pos
+    std::atomic<uint32_t> pos;    // 5 bits per entry: where the key falls within the cluster, for resizing
+    std::atomic<U64> data[6];     // move, score, eval, depth, bound and date, packed by ChessHeapClass
+};
+
+struct sHashEntry {           // copy of a transposition table entry, as returned by ChessHeapClass::Probe()
+    int move;
+    int score;                // mate scores are relative to the probing ply
+    int eval;                 // NO_EVAL if not known
+    int depth;
+    int flags;                // NONE if the position was not found
+
+    bool Cuts(int alpha, int beta, int minDepth) const { // does the entry decide a search to minDepth?
+        return depth >= minDepth
+            && ((flags & UPPER && score <= alpha) || (flags & LOWER && score >= beta));
+    }
 };
 
 struct eData {
@@ -451,6 +497,7 @@ struct eData {
     U64 p_takes[2];
     U64 two_pawns_take[2];
     U64 p_can_take[2];
+    U64 passers[2];
     U64 all_att[2];
     U64 ev_att[2];
 };
@@ -460,14 +507,56 @@ struct sEvalHashEntry {
     int score;
 };
 
-struct sPawnHashEntry {
+// Material hash entries hold the parts of the evaluation that depend only on
+// piece counts (and on which side the program plays, due to keep_pc)
+
+struct sMaterialHashEntry {
     U64 key;
-    int mg_pawns;
-    int eg_pawns;
+    int mg;                             // material adjustments, white minus black
+    int eg;
+    int imbalance;                      // added after interpolation
 };
 
-struct Line {
-	int pv[MAX_PLY];
+// The pawn hash is shared by all threads and accessed without locks. Each entry
+// stores its key xor-ed with all the other words, so an entry torn by a
+// concurrent write no longer matches its key and reads as a miss. Besides the
+// score, an entry keeps the pawn bitboards that the rest of the evaluation
+// needs; pawn-only data depends on the pawn key alone (which includes kings).
+
+struct alignas(64) sPawnHashEntry {
+    std::atomic<U64> check;             // pawn key ^ all the words below
+    std::atomic<U64> data;              // midgame and endgame pawn score
+    std::atomic<U64> p_takes[2];        // squares attacked by pawns
+    std::atomic<U64> two_pawns_take[2]; // squares attacked by two pawns
+    std::atomic<U64> passers[2];        // passed pawns
+};
+
+class cPawnHash {
+    sPawnHashEntry *mTable;
+    void *mMem;             // as returned by malloc()
+    U64 mMask;
+
+  public:
+    cPawnHash(): mTable(nullptr), mMem(nullptr), mMask(0) {};
+    ~cPawnHash() { std::free(mMem); }
+
+    void Alloc(int mbsize);
+    void Clear();
+    void Prefetch(U64 key) const { PREFETCH(mTable + (key & mMask)); }
+    bool Retrieve(U64 key, eData *e) const;
+    void Store(U64 key, const eData *e, int mg, int eg);
+};
+
+constexpr int PAWN_HASH_DEF_MB = 8;
+
+extern cPawnHash PawnHash;
+
+struct sRootMove {   // what the current search knows about a root move
+    int move;
+    int score;       // exact score from the current iteration, -INF if the move is not among the best lines
+    int prevScore;   // the same from the previous iteration
+    U64 nodes;       // nodes spent on this move so far
+    int pv[MAX_PLY];
 };
 
 enum Values {
@@ -719,8 +808,6 @@ class cMask {
 extern cMask Mask;
 
 #if defined(USE_THREADS)
-    #include <atomic>
-
     using glob_bool = std::atomic<bool>;
     using glob_int  = std::atomic<int>;
     using glob_U64  = std::atomic<uint64_t>;
@@ -730,10 +817,11 @@ extern cMask Mask;
     using glob_U64  = uint64_t;
 #endif
 
+enum { BIND_NONE, BIND_CORES, BIND_NODES };
+
 class cGlobals {
   public:
     glob_int threadOverride;
-    glob_U64 nodes;
     glob_bool abortSearch;
     glob_bool isTesting;
 	bool is_noisy;
@@ -751,18 +839,15 @@ class cGlobals {
     glob_int depthReached;
     int moves_from_start; // to restrict book depth for weaker levels
     int thread_no;
+    int thread_binding;   // BIND_NONE, BIND_CORES or BIND_NODES
 	int multiPv;
     int time_buffer;
 	bool timeTricks;
     U64 game_key;         // random key initialized on ucinewgame to ensure non-repeating random eval modification for weak personalities
-    int avoidMove[MAX_PV + 1]; // list of moves to avoid in multi-pv re-searches
 
     void ClearData();
     void Init();
     bool CanReadBook();
-	bool MoveToAvoid(int move);
-	void ClearAvoidList();
-	void SetAvoidMove(int loc, int move);
 };
 
 extern cGlobals Glob;
@@ -815,14 +900,24 @@ extern
 #endif
 sInternalBook InternalBook;
 
-void CheckTimeout();
+#ifndef USE_THREADS
+    void CheckTimeout();
+#endif
+
+// Transposition table entries carry the static eval, so the eval hash only
+// saves work at nodes that miss the main table (mostly quiescence nodes).
+// Build with -DNO_EVAL_HASH to leave it out.
 
+#ifndef NO_EVAL_HASH
 constexpr int EVAL_HASH_SIZE = 512 * 512 / 4;
-constexpr int PAWN_HASH_SIZE = 512 * 512 / 4;
+#endif
+constexpr int MATERIAL_HASH_SIZE = 4096;
 
 class cEngine {
+#ifndef NO_EVAL_HASH
     sEvalHashEntry mEvalTT[EVAL_HASH_SIZE];
-    sPawnHashEntry mPawnTT[PAWN_HASH_SIZE];
+#endif
+    sMaterialHashEntry mMaterialTT[MATERIAL_HASH_SIZE];
     int mHistory[12][64];
     int mEvalStack[MAX_PLY];
     int mKiller[MAX_PLY][2];
@@ -830,6 +925,8 @@ class cEngine {
     const int mcThreadId;
     int mRootDepth;
     bool mFlRootChoice;
+    sRootMove mRootMoves[MAX_MOVES];
+    int mRootMoveCnt;
 	int mEngSide;
 
 #ifdef USE_TUNING
@@ -845,6 +942,7 @@ class cEngine {
 
 #endif
 
+    void PrefetchMove(POS *p, int move);
     static void InitCaptures(POS *p, MOVES *m);
     void InitMoves(POS *p, MOVES *m, int trans_move, int ref_move, int ref_sq, int ply);
     int NextMove(MOVES *m, int *flag, int ply);
@@ -858,7 +956,6 @@ class cEngine {
     void ClearHist();
     void AgeHist();
     void ClearEvalHash();
-    void ClearPawnHash();
     int Refutation(int move);
     void UpdateHistory(POS *p, int last_move, int move, int depth, int ply);
     void DecreaseHistory(POS *p, int move, int depth);
@@ -867,18 +964,24 @@ class cEngine {
     void Iterate(POS *p, int *pv);
     int Widen(POS *p, int depth, int *pv, int lastScore);
 	int SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv);
+    void InitRootMoves(POS *p);
+    void SearchRootMoves(POS *p, int depth, int lines);
+    int SearchRootMove(POS *p, int move, int moveNo, int depth, int floor, int guess, int *pv);
+    void SortRootMoves();
     int Search(POS *p, int ply, int alpha, int beta, int depth, bool was_null, int last_move, int last_capt_sq, int *pv);
     int QuiesceChecks(POS *p, int ply, int alpha, int beta, int *pv);
     int QuiesceFlee(POS *p, int ply, int alpha, int beta, int *pv);
     int Quiesce(POS *p, int ply, int alpha, int beta, int *pv);
     void DisplayPv(int multipv, int score, int *pv);
+    void StoreHash(U64 key, int move, int score, int eval, int flags, int depth, int ply);
     void Slowdown();
     int SetNullReductionDepth(int depth, int eval, int beta);
 
     int Evaluate(POS *p, eData *e);
 
     static int EvaluateChains(POS *p, eColor sd);
-    static void EvaluateMaterial(POS *p, eData *e, eColor sd);
+    static int EvaluateMaterial(POS *p, eColor sd);
+    const sMaterialHashEntry *ProbeMaterial(POS *p);
     static void EvaluatePieces(POS *p, eData *e, eColor sd);
 	static void EvaluateShielded(POS *p, eData *e, eColor sd, int sq, int v1, int v2, int *outpost_mg, int *outpost_eg);
     static void EvaluateOutpost(POS *p, eData *e, eColor sd, int pc, int sq, int *outpost_mg, int *outpost_eg);
@@ -920,6 +1023,7 @@ class cEngine {
     static const int mscSnpDepth;      // max depth at which static null move pruning is applied
     static const int mscRazorDepth;    // max depth at which razoring is applied
     static const int mscFutDepth;      // max depth at which futility pruning is applied
+    static const int mscDeferDepth;    // min depth at which moves searched by other threads are deferred
     static int msLmrSize[2][MAX_PLY][MAX_MOVES];
 
   public:
@@ -933,20 +1037,54 @@ class cEngine {
 
     int mPvEng[MAX_PLY];
     int mDpCompleted;
+    U64 mHashStores[STORE_RESULTS]; // transposition table stores by eHashStore, since the last clear
+
+    // Per-thread state that the other threads read: nodes searched (summed on
+    // demand by GetNodes()) and the iteration being searched (for depth
+    // coverage in Lazy SMP). The padding keeps them on a cache line of their
+    // own, so that updating them never touches memory written by other threads.
+
+    char mSharedPad0[64];
+    glob_U64 mNodes;
+    glob_int mIterDepth;
+    char mSharedPad1[64];
+
+    void IncNodes() {
+#ifdef USE_THREADS
+        mNodes.store(mNodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#else
+        mNodes++;
+#endif
+    }
 
     cEngine(const cEngine&) = delete;
     cEngine& operator=(const cEngine&) = delete;
-    cEngine(int th = 0): mcThreadId(th) { ClearAll(); };
+#ifndef USE_THREADS
+    cEngine(int th = 0): mcThreadId(th), mNodes(0), mIterDepth(0) { ClearAll(); };
+#else
+    // Every engine owns a worker thread that lives as long as the engine and
+    // sleeps on a condition variable between tasks, so that `go` doesn't have
+    // to create threads. Engines (and their workers) are only recreated when
+    // the number of threads changes.
 
-#ifdef USE_THREADS
+  private:
     std::thread mWorker;
-    void StartThinkThread(POS *p) {
-        mDpCompleted = 0;
-        mWorker = std::thread([&] { Think(p); });
-    }
+    std::mutex mTaskMutex;
+    std::condition_variable mTaskCond;
+    std::function<void()> mTask; // empty while the worker is parked
+    bool mExit;
+
+    void IdleLoop();
+
+  public:
+    cEngine(int th = 0): mcThreadId(th), mNodes(0), mIterDepth(0), mExit(false) {
+        ClearAll();
+        mWorker = std::thread(&cEngine::IdleLoop, this);
+    };
 
-    ~cEngine() { WaitThinkThread(); };  // should fix crash on windows on console closing
-    void WaitThinkThread() { if (mWorker.joinable()) mWorker.join(); }
+    ~cEngine();
+    void StartTask(std::function<void()> task);
+    void WaitTask();
 #endif
 
     static void SetMoveTime(int base, int inc, int movestogo);
@@ -968,15 +1106,20 @@ class cEngine {
 #ifdef USE_THREADS
     #include <list>
     extern std::list<cEngine> Engines;
+    int MaxThreads();
+    void SetThreads(int count);
 #else
     extern cEngine EngineSingle;
 #endif
 
 void PrintVersion();
 
+void BindThreads();
 void DisplayCurrmove(int move, int tried);
 void ExtractMove(int *pv);
 int GetMS();
+void ResetNodes();
+U64 GetNodes();
 U64 GetNps(int elapsed);
 bool InputAvailable();
 char *MoveToStr(int move); // returns internal static string. not thread safe!!!
@@ -993,6 +1136,9 @@ void ReadThreadNumber(const char *fileName);
 void SetPieceValue(int pc, int val, int slot);
 void UciLoop();
 int my_random(int n);
+#if defined(__linux__)
+    int ReadSysList(const char *path, int *list, int max);
+#endif
 
 extern const int tp_value[7];
 extern const int ph_value[7];
@@ -1048,7 +1194,27 @@ extern const int ph_value[7];
 #include "chessheapclass.h"
 extern ChessHeapClass Trans;
 
-extern int tDepth[MAX_THREADS];
+inline void cEngine::StoreHash(U64 key, int move, int score, int eval, int flags, int depth, int ply) {
+    mHashStores[Trans.Store(key, move, score, eval, flags, depth, ply)]++;
+}
+
+// Lazy SMP threads tend to search the same moves of a node in the same order.
+// ABDADA-style, a thread postpones a move while another thread is busy with the
+// resulting position and comes back to it after the rest of the node. Busy
+// positions are recorded by hash key in a small table shared by all threads;
+// a collision merely makes a move be searched earlier or later than it should.
+
+class cDeferTable {
+    static const int size = 1 << 15;
+    std::atomic<U64> keys[size];
+
+  public:
+    bool IsBusy(U64 key) const { return keys[key & (size - 1)].load(std::memory_order_relaxed) == key; }
+    void Mark(U64 key) { keys[key & (size - 1)].store(key, std::memory_order_relaxed); }
+    void Unmark(U64 key) { keys[key & (size - 1)].compare_exchange_strong(key, 0, std::memory_order_relaxed); }
+};
+
+extern cDeferTable Defer;
 
 // TODO: continuation move
 // TODO: easy move code
@@ -24,6 +24,7 @@ If not, see <http://www.gnu.org/licenses/>.
 const int cEngine::mscSnpDepth = 3;       // max depth at which static null move pruning is applied
 const int cEngine::mscRazorDepth = 4;     // max depth at which razoring is applied
 const int cEngine::mscFutDepth = 6;       // max depth at which futility pruning is applied
+const int cEngine::mscDeferDepth = 4;     // min depth at which moves searched by other threads are deferred
 
 // this variable controls when evaluation function needs to be called for the sake of pruning
 const int cEngine::mscSelectiveDepth = Max(Max(mscSnpDepth, mscRazorDepth), mscFutDepth);
@@ -32,6 +33,8 @@ const int cEngine::mscRazorMargin[5] = { 0, 300, 360, 420, 480 };
 const int cEngine::mscFutMargin[7] = { 0, 100, 150, 200, 250, 300, 400 };
 int cEngine::msLmrSize[2][MAX_PLY][MAX_MOVES];
 
+cDeferTable Defer;
+
 void cParam::InitAsymmetric(POS *p) {
 
     programSide = p->mSide;
@@ -52,37 +55,21 @@ void cParam::InitAsymmetric(POS *p) {
 
 void cGlobals::ClearData() {
 
-    Trans.Clear();
+    if (!Trans.Shared()) // other engines may be using it
+        Trans.Clear();
+    PawnHash.Clear();
 #ifndef USE_THREADS
     EngineSingle.ClearAll();
 #else
-    for (auto& engine : Engines) {
-        engine.ClearAll();
-    }
+    for (auto& engine : Engines) // each engine clears its own tables
+        engine.StartTask([&engine] { engine.ClearAll(); });
+
+    for (auto& engine : Engines)
+        engine.WaitTask();
 #endif
     shouldClear = false;
 }
 
-bool cGlobals::MoveToAvoid(int move) {
-
-    for (int i = 0; i <= MAX_PV; i++) {
-        if (avoidMove[i] == move) return true;
-    }
-
-    return false;
-}
-
-void cGlobals::ClearAvoidList() {
-
-    for (int i = 0; i <= MAX_PV; i++) {
-        avoidMove[i] = 0;
-    }
-}
-
-void cGlobals::SetAvoidMove(int loc, int move) {
-    avoidMove[loc] = move;
-}
-
 void cEngine::InitSearch() { // static init function
 
     // Set depth of late move reduction (formula based on Stockfish)
@@ -117,7 +104,6 @@ void cEngine::Think(POS *p) {
     POS curr[1];
     mPvEng[0] = 0; // clear engine's move
     mPvEng[1] = 0; // clear ponder move
-    Glob.ClearAvoidList();
     Glob.scoreJump = false;
     mFlRootChoice = false;
     *curr = *p;
@@ -126,69 +112,254 @@ void cEngine::Think(POS *p) {
     mEngSide = p->mSide;
 }
 
-void cEngine::MultiPv(POS * p, int * pv) {
+#ifdef USE_THREADS
+
+void cEngine::IdleLoop() {
 
-    int val[MAX_PV + 1];
-    int bestPv = 1;
-    int bestScore;
+    std::unique_lock<std::mutex> lock(mTaskMutex);
 
-    Line line[MAX_PV + 1];
+    for (;;) {
+        mTaskCond.wait(lock, [this] { return mTask || mExit; });
+        if (mExit) return;
 
-    for (int i = 0; i <= MAX_PV; i++) {
-        val[i] = 0;
+        lock.unlock();
+        mTask();
+        lock.lock();
+
+        mTask = nullptr;
+        mTaskCond.notify_all();
     }
+}
 
-    for (mRootDepth = 1; mRootDepth <= msSearchDepth; mRootDepth++) {
-        Glob.ClearAvoidList();
-        bestScore = -INF;
-        bestPv = 0;
+void cEngine::StartTask(std::function<void()> task) {
 
-        val[1] = Widen(p, mRootDepth, line[1].pv, val[1]);
+    std::unique_lock<std::mutex> lock(mTaskMutex);
+    mTaskCond.wait(lock, [this] { return !mTask; }); // a task still running would be lost
+    mTask = std::move(task);
+    mTaskCond.notify_all();
+}
 
-        if (Glob.abortSearch) {
-            break;
-        }
+void cEngine::WaitTask() {
 
-        if (val[1] > bestScore) {
-            bestPv = 1;
-            bestScore = val[1];
-        };
+    std::unique_lock<std::mutex> lock(mTaskMutex);
+    mTaskCond.wait(lock, [this] { return !mTask; });
+}
 
-        Glob.SetAvoidMove(1, line[1].pv[0]);
+cEngine::~cEngine() { // should fix crash on windows on console closing
 
-        for (int i = 2; i <= Glob.multiPv; i++) {
+    WaitTask();
+    {
+        std::lock_guard<std::mutex> lock(mTaskMutex);
+        mExit = true;
+        mTaskCond.notify_all();
+    }
+    mWorker.join();
+}
 
-            val[i] = Widen(p, mRootDepth, line[i].pv, val[i]);
+#endif
 
-            if (Glob.abortSearch) {
-                break;
-            }
+// MultiPV search keeps a table of all root moves. Every iteration goes through
+// the table once: the best lines get exact scores, and each other move is only
+// tested against the worst of them, so no move is searched twice per depth.
+// With more threads each one works through its own table, sharing results via
+// the transposition table as in Iterate(); the lines of a depth are reported
+// by the thread that completes it first.
 
-            if (val[i] > bestScore) {
-                bestPv = i;
-                bestScore = val[i];
-            };
+void cEngine::MultiPv(POS *p, int *pv) {
 
-            Glob.SetAvoidMove(i, line[i].pv[0]);
+    POS curr[1];
+    *curr = *p;
+    pv[0] = 0;
+    pv[1] = 0;
+
+    InitRootMoves(curr);
+    const int lines = Min(Glob.multiPv, mRootMoveCnt);
+    const int offset = mcThreadId & 0x01;
+
+    for (mRootDepth = 1 + offset; mRootDepth <= msSearchDepth && mRootMoveCnt; mRootDepth++) {
+
+        mIterDepth = mRootDepth;
+
+        // skip an iteration if other threads are already too far ahead
+
+        if (Glob.depthReached > mDpCompleted + 1) {
+            mDpCompleted++;
+            continue;
         }
 
-        if (Glob.abortSearch) {
+        for (int i = 0; i < mRootMoveCnt; i++) {
+            mRootMoves[i].prevScore = mRootMoves[i].score;
+            mRootMoves[i].score = -INF;
+        }
+
+        SearchRootMoves(curr, mRootDepth, lines);
+
+        // results of an interrupted iteration are incomplete, keep the previous ones
+
+        if (Glob.abortSearch && mRootDepth > 1) {
+            for (int i = 0; i < mRootMoveCnt; i++)
+                mRootMoves[i].score = mRootMoves[i].prevScore;
             break;
         }
 
-        for (int i = Glob.multiPv; i > 0; i--) {
-            if (p->Legal(line[i].pv[0])) {
-                DisplayPv(i, val[i], line[i].pv);
+        SortRootMoves();
+
+        // only now is the first move the best one
+
+        if (!Glob.abortSearch)
+            StoreHash(curr->mHashKey, mRootMoves[0].move, mRootMoves[0].score, NO_EVAL, EXACT, mRootDepth, 0);
+
+        mDpCompleted = mRootDepth;
+        if (Glob.depthReached < mDpCompleted) {
+            Glob.depthReached = mDpCompleted;
+            for (int i = 0; i < lines; i++)
+                DisplayPv(i + 1, mRootMoves[i].score, mRootMoves[i].pv);
+        }
+
+        if (Glob.abortSearch) break;
+    }
+
+    if (!Par.shut_up) Glob.abortSearch = true; // let the other threads know a fixed depth search is over
+
+    if (mRootMoveCnt)
+        BuildPv(pv, mRootMoves[0].pv + 1, mRootMoves[0].move);
+}
+
+void cEngine::InitRootMoves(POS *p) {
+
+    int move, moveType, hashMove = 0;
+    MOVES m[1];
+    UNDO u[1];
+
+    Trans.RetrieveMove(p->mHashKey, &hashMove);
+    InitMoves(p, m, hashMove, Refutation(hashMove), -1, 0);
+    mRootMoveCnt = 0;
+
+    while ((move = NextMove(m, &moveType, 0))) {
+        p->DoMove(move, u);
+        if (!p->Illegal()) {
+            sRootMove *rm = &mRootMoves[mRootMoveCnt++];
+            rm->move = move;
+            rm->score = rm->prevScore = -INF;
+            rm->nodes = 0;
+            rm->pv[0] = move;
+            rm->pv[1] = 0;
+        }
+        p->UndoMove(move, u);
+    }
+}
+
+void cEngine::SearchRootMoves(POS *p, int depth, int lines) {
+
+    int newPv[MAX_PLY];
+    int best[MAX_PV];  // scores of the best lines so far, in descending order
+    int found = 0;     // number of moves with an exact score
+
+    for (int i = 0; i < mRootMoveCnt; i++) {
+
+        sRootMove *rm = &mRootMoves[i];
+        const int floor = found < lines ? -INF : best[lines - 1];
+        const U64 nodesBefore = mNodes;
+        const int score = SearchRootMove(p, rm->move, i + 1, depth, floor, rm->prevScore, newPv);
+
+        rm->nodes += mNodes - nodesBefore;
+        if (Glob.abortSearch && mRootDepth > 1) return;
+
+        // a move that makes it into the best lines gets its score and pv recorded
+
+        if (score > floor) {
+            rm->score = score;
+            BuildPv(rm->pv, newPv, rm->move);
+
+            int j = Min(found, lines - 1);
+            while (j > 0 && best[j - 1] < score) {
+                best[j] = best[j - 1];
+                j--;
             }
+            best[j] = score;
+            found++;
         }
+    }
+}
+
+// Returns the exact score of a root move if it is above floor, otherwise some
+// score not above floor. Deeper searches use a window around guess, widened
+// the same way as in Widen().
+
+int cEngine::SearchRootMove(POS *p, int move, int moveNo, int depth, int floor, int guess, int *pv) {
+
+    const bool isQuiet = p->TpOnSq(Tsq(move)) == NO_TP && (MoveType(move) == NORMAL || MoveType(move) == EP_SET);
+    const bool flagInCheck = p->InCheck();
+    const int lastCapt = isQuiet ? -1 : Tsq(move);
+    const int moveHistScore = mHistory[p->mPc[Fsq(move)]][Tsq(move)];
+    int score, alpha = floor, beta = INF, margin = 8, reduction = 0;
+    UNDO u[1];
+
+    PrefetchMove(p, move);
+    p->DoMove(move, u);
+    const int newDepth = depth - 1 + p->InCheck();
+
+    // most moves don't make it into the best lines, and a zero window search
+    // (reduced for late quiet moves, as in SearchRoot()) proves that cheaply
+
+    if (floor > -INF) {
+        if (depth > 2
+        && Par.searchSkill > 2
+        && moveNo > 3
+        && isQuiet
+        && !flagInCheck
+        && !p->InCheck()
+        && moveHistScore < Par.histLimit) {
+            reduction = Min((int)msLmrSize[0][depth][moveNo], newDepth - 1);
+        }
+
+        score = -Search(p, 1, -floor - 1, -floor, newDepth - reduction, false, move, lastCapt, pv);
+        if (!Glob.abortSearch && score > floor && reduction > 0)
+            score = -Search(p, 1, -floor - 1, -floor, newDepth, false, move, lastCapt, pv);
+        if (Glob.abortSearch || score <= floor) {
+            p->UndoMove(move, u);
+            return score;
+        }
+        guess = Max(guess, score);
+    }
 
-        pv = line[1].pv;
+    if (depth > 6 && guess > -MAX_EVAL && guess < MAX_EVAL) {
+        alpha = Max(floor, guess - margin);
+        beta = guess + margin;
     }
 
-    if (bestPv == 0) {
-        ExtractMove(line[1].pv);
-    } else {
-        ExtractMove(line[bestPv].pv);
+    for (;;) {
+        score = -Search(p, 1, -beta, -alpha, newDepth, false, move, lastCapt, pv);
+        if (Glob.abortSearch) break;
+
+        if (score <= alpha) {
+            if (alpha == floor) break;
+            margin *= 2;
+            alpha = margin < 500 ? Max(floor, score - margin) : floor;
+        } else if (score >= beta) {
+            margin *= 2;
+            beta = margin < 500 ? score + margin : INF;
+        } else break;
+    }
+
+    p->UndoMove(move, u);
+    return score;
+}
+
+// Moves with exact scores go first, best first; the rest follow in the order
+// of effort spent on them. The sort is stable, so full ties keep their order.
+
+void cEngine::SortRootMoves() {
+
+    for (int i = 1; i < mRootMoveCnt; i++) {
+        sRootMove tmp = mRootMoves[i];
+        int j = i;
+        while (j > 0 && (mRootMoves[j - 1].score < tmp.score
+               || (mRootMoves[j - 1].score == tmp.score && mRootMoves[j - 1].nodes < tmp.nodes))) {
+            mRootMoves[j] = mRootMoves[j - 1];
+            j--;
+        }
+        mRootMoves[j] = tmp;
     }
 }
 
@@ -204,11 +375,13 @@ void cEngine::Iterate(POS *p, int *pv) {
 
     for (mRootDepth = 1 + offset; mRootDepth <= msSearchDepth; mRootDepth++) {
 
-        tDepth[mcThreadId] = mRootDepth;
+        mIterDepth = mRootDepth;
         depthCounter = 0;
-        for (int j = 0; j < Glob.thread_no; j++) {
-            if (tDepth[j] >= mRootDepth) depthCounter++;
+#ifdef USE_THREADS
+        for (auto& engine : Engines) {
+            if (engine.mIterDepth >= mRootDepth) depthCounter++;
         }
+#endif
 
         // skip depth if it already has good coverage in multi-threaded mode
 
@@ -316,7 +489,7 @@ int cEngine::Widen(POS *p, int depth, int *pv, int lastScore) {
 int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv) {
 
     int best, score = -INF, move, newDepth, new_pv[MAX_PLY];
-    int mv_type, reduction, victim, last_capt, hashFlag;
+    int mv_type, reduction, victim, last_capt;
     int singMove = -1, singScore = -INF;
     int mv_tried = 0;
     int mv_played[MAX_MOVES];
@@ -325,7 +498,7 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     MOVES m[1];
     UNDO u[1];
     eData e;
-    int hashScore = -INF;
+    sHashEntry hash;
 
     bool flagInCheck;
     bool flagExtended;
@@ -334,23 +507,25 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    IncNodes();
     Slowdown();
     if (Glob.abortSearch && mRootDepth > 1) return 0;
     if (ply) *pv = 0;
     if (p->IsDraw() && ply) return p->DrawScore();
-    move = 0;
 
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
 
-    if (Trans.Retrieve(p->mHashKey, &move, &hashScore, &hashFlag, alpha, beta, depth, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hash);
+    move = hash.move;
+
+    if (hash.Cuts(alpha, beta, depth)) {
 
-        if (hashScore >= beta) {
+        if (hash.score >= beta) {
             UpdateHistory(p, -1, move, depth, ply);
         }
 
         if (!isPv && Par.searchSkill > 0) {
-            return hashScore;
+            return hash.score;
         }
 
     }
@@ -358,10 +533,10 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
     // PREPARE FOR SINGULAR EXTENSION, SENPAI-STYLE
 
     if (isPv && depth > 5) {
-        if (Trans.Retrieve(p->mHashKey, &singMove, &singScore, &hashFlag, alpha, beta, depth - 4, ply)) {
-            if (hashFlag & LOWER) {
-                canSing = true;
-            }
+        if (hash.Cuts(alpha, beta, depth - 4) && (hash.flags & LOWER)) {
+            canSing = true;
+            singMove = hash.move;
+            singScore = hash.score;
         }
     }
 
@@ -405,6 +580,7 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
             last_capt = -1;
         }
 
+        PrefetchMove(p, move);
         p->DoMove(move, u);
 
         if (p->Illegal()) {
@@ -412,13 +588,6 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
             continue;
         }
 
-        // DON'T SEARCH THE SAME MOVES IN MULTI-PV MODE 
-
-        if (Glob.MoveToAvoid(move)) {
-            p->UndoMove(move, u);
-            continue;
-        }
-
         // GATHER INFO ABOUT THE MOVE
 
         flagExtended = false;
@@ -525,7 +694,7 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
                     DecreaseHistory(p, mv_played[mv], depth);
                 }
             }
-            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply);
+            StoreHash(p->mHashKey, move, score, NO_EVAL, LOWER, depth, ply);
 
             // At root, change the best move and show the new pv
 
@@ -564,10 +733,10 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
                 DecreaseHistory(p, mv_played[mv], depth);
             }
         }
-        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply);
+        StoreHash(p->mHashKey, *pv, best, NO_EVAL, EXACT, depth, ply);
     }
     else
-        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply);
+        StoreHash(p->mHashKey, 0, best, NO_EVAL, UPPER, depth, ply);
 
     return best;
 }
@@ -575,18 +744,21 @@ int cEngine::SearchRoot(POS *p, int ply, int alpha, int beta, int depth, int *pv
 
 int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNull, int lastMove, int lastCaptSquare, int *pv) {
 
-    int best, score = -INF, nullScore, move, newDepth, newPv[MAX_PLY];
-    int moveType, reduction, victim, lastCaptTarget, hashFlag, nullHashFlag;
+    int best, score = -INF, move, newDepth, newPv[MAX_PLY];
+    int moveType, reduction, victim, lastCaptTarget;
     int nullRefutation = -1, refutationSqare = -1, singMove = -1, singScore = -INF;
     int movesTried = 0;
     int movesPlayed[MAX_MOVES];
+    int deferredMoves[MAX_DEFERRED], deferredTypes[MAX_DEFERRED];
+    int deferredCnt = 0, deferredNext = 0;
     int quietTried = 0;
     int moveHistScore = 0;
+    U64 childKey = 0;
     MOVES m[1];
     UNDO u[1];
     eData e;
     int moveSEEscore = 0; // see score of a bad capture
-    int hashScore = -INF;
+    sHashEntry hash;
 
     bool flagInCheck;
     bool flagExtended;
@@ -594,6 +766,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
     bool didNull = false;
     bool isPv = (alpha != beta - 1);
     bool canSing = false;
+    bool canDefer = (Glob.thread_no > 1 && depth >= mscDeferDepth);
 
     // QUIESCENCE SEARCH ENTRY POINT
 
@@ -603,7 +776,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
 
     // EARLY EXIT AND NODE INITIALIZATION
 
-    Glob.nodes++;
+    IncNodes();
     Slowdown();
     if (Glob.abortSearch && mRootDepth > 1) return 0;
     *pv = 0;
@@ -628,30 +801,32 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         }
     }
 
-    bool hasTT = false;
-
     // RETRIEVE MOVE FROM TRANSPOSITION TABLE
+    // (this probe serves all the hash table decisions at this node)
 
-    if (Trans.Retrieve(p->mHashKey, &move, &hashScore, &hashFlag, alpha, beta, depth, ply)) {
+    Trans.Probe(p->mHashKey, ply, &hash);
+    move = hash.move;
 
-        hasTT = true;
+    bool hasTT = hash.Cuts(alpha, beta, depth);
+
+    if (hasTT) {
 
-        if (hashScore >= beta) {
+        if (hash.score >= beta) {
             UpdateHistory(p, lastMove, move, depth, ply);
         }
 
         if (!isPv && Par.searchSkill > 0) {
-            return hashScore;
+            return hash.score;
         }
     }
 
     // PREPARE FOR SINGULAR EXTENSION, SENPAI-STYLE
 
     if (isPv && depth > 5) {
-        if (Trans.Retrieve(p->mHashKey, &singMove, &singScore, &hashFlag, alpha, beta, depth - 4, ply)) {
-            if (hashFlag & LOWER) {
-                canSing = true;
-            }
+        if (hash.Cuts(alpha, beta, depth - 4) && (hash.flags & LOWER)) {
+            canSing = true;
+            singMove = hash.move;
+            singScore = hash.score;
         }
     }
 
@@ -671,17 +846,20 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         && alpha > -MAX_EVAL
         && beta < MAX_EVAL;
 
-    // GET EVAL SCORE FOR PRUNING/REDUCTION DECISIONS
+    // GET EVAL SCORE FOR PRUNING/REDUCTION DECISIONS (A HASH ENTRY MAY ALREADY HOLD IT)
 
     int eval = 0;
     if (flagInCheck) eval = -INF;
+    else if (hash.eval != NO_EVAL) eval = hash.eval;
     else eval = Evaluate(p, &e);
 
+    const int staticEval = eval; // stored in the transposition table
+
     // ADJUST EVAL USING HASH SCORE,THEN SAVE TO STACK
 
     if (hasTT) {
-        if (hashFlag & (hashScore > eval ? LOWER : UPPER))
-            eval = hashScore;
+        if (hash.flags & (hash.score > eval ? LOWER : UPPER))
+            eval = hash.score;
     }
 
     mEvalStack[ply] = eval;
@@ -726,9 +904,8 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         // omit null move search if normal search to the same depth wouldn't exceed beta
         // (sometimes we can check it for free via hash table)
 
-        if (Trans.Retrieve(p->mHashKey, &move, &nullScore, &nullHashFlag, alpha, beta, newDepth, ply)) {
-            if (nullScore < beta) goto avoidNull;
-        }
+        if (hash.Cuts(alpha, beta, newDepth) && hash.score < beta)
+            goto avoidNull;
 
         p->DoNull(u);
         if (newDepth <= 0) score = -QuiesceChecks(p, ply + 1, -beta, -beta + 1, newPv);
@@ -737,7 +914,7 @@ int cEngine::Search(POS *p, int ply, int alpha, int beta, int depth, bool wasNul
         // get location of a piece whose capture refuted null move
         // its escape will be prioritised in the move ordering
 
-        Trans.Retrieve(p->mHashKey, &nullRefutation, &nullScore, &nullHashFlag, alpha, beta, depth, ply);
+        Trans.RetrieveMove(p->mHashKey, &nullRefutation);
         if (nullRefutation > 0) refutationSqare = Tsq(nullRefutation);
 
         p->UndoNull(u);
@@ -800,8 +977,11 @@ avoidNull:
     InitMoves(p, m, move, Refutation(move), refutationSqare, ply);
 
     // MAIN LOOP
+    // (once the move list is exhausted, moves deferred because other threads
+    // were searching them are taken in the order they were put aside)
 
-    while ((move = NextMove(m, &moveType, ply))) {
+    while ((move = NextMove(m, &moveType, ply))
+    ||     (deferredNext < deferredCnt && (moveType = deferredTypes[deferredNext], (move = deferredMoves[deferredNext++])))) {
 
         // SET FUTILITY PRUNING FLAG
         // before the first applicable move is tried
@@ -835,12 +1015,29 @@ avoidNull:
 
         // MAKE MOVE
 
+        PrefetchMove(p, move);
         p->DoMove(move, u);
         if (p->Illegal()) { 
             p->UndoMove(move, u); 
             continue; 
         }
 
+        // DEFER A MOVE ANOTHER THREAD IS SEARCHING
+
+        if (canDefer) {
+            childKey = p->mHashKey;
+            if (movesTried
+            && deferredNext == 0
+            && deferredCnt < MAX_DEFERRED
+            && Defer.IsBusy(childKey)) {
+                p->UndoMove(move, u);
+                deferredMoves[deferredCnt] = move;
+                deferredTypes[deferredCnt] = moveType;
+                deferredCnt++;
+                continue;
+            }
+        }
+
         // GATHER INFO ABOUT THE MOVE
 
         flagExtended = false;
@@ -1008,6 +1205,11 @@ avoidNull:
             newDepth -= reduction;
         }
 
+        // Only now is the move sure to be searched, so mark its child as busy
+        // (pruned moves are undone without a search, and must not stay marked)
+
+        if (canDefer) Defer.Mark(childKey);
+
     research:
 
         // PRINCIPAL VARIATION SEARCH
@@ -1030,6 +1232,7 @@ avoidNull:
 
         // UNDO MOVE
 
+        if (canDefer) Defer.Unmark(childKey);
         p->UndoMove(move, u);
         if (Glob.abortSearch && mRootDepth > 1) return 0;
 
@@ -1042,7 +1245,7 @@ avoidNull:
                     DecreaseHistory(p, movesPlayed[mv], depth);
                 }
             }
-            Trans.Store(p->mHashKey, move, score, LOWER, depth, ply);
+            StoreHash(p->mHashKey, move, score, staticEval, LOWER, depth, ply);
 
             return score;
         }
@@ -1074,24 +1277,61 @@ avoidNull:
                 DecreaseHistory(p, movesPlayed[mv], depth);
             }
         }
-        Trans.Store(p->mHashKey, *pv, best, EXACT, depth, ply);
+        StoreHash(p->mHashKey, *pv, best, staticEval, EXACT, depth, ply);
     } else
-        Trans.Store(p->mHashKey, 0, best, UPPER, depth, ply);
+        StoreHash(p->mHashKey, 0, best, staticEval, UPPER, depth, ply);
 
     return best;
 }
 
+// Start loading the hash entries of the position after the move, so that they
+// are in cache by the time the child node probes them
+
+void cEngine::PrefetchMove(POS *p, int move) {
+
+    U64 pawn_key;
+    U64 key = p->KeyAfter(move, &pawn_key);
+
+    Trans.Prefetch(key);
+#ifndef NO_EVAL_HASH
+    PREFETCH(&mEvalTT[key % EVAL_HASH_SIZE]);
+#endif
+    PawnHash.Prefetch(pawn_key);
+}
+
 int cEngine::SetNullReductionDepth(int depth, int eval, int beta) {
 
     return depth - ((823 + 67 * depth) / 256)
                  - Min(3, (eval - beta) / 200);
 }
 
+void ResetNodes() {
+
+#ifndef USE_THREADS
+    EngineSingle.mNodes = 0;
+#else
+    for (auto& engine : Engines)
+        engine.mNodes = 0;
+#endif
+}
+
+U64 GetNodes() {
+
+#ifndef USE_THREADS
+    return EngineSingle.mNodes;
+#else
+    U64 nodes = 0;
+    for (auto& engine : Engines)
+        nodes += engine.mNodes;
+    return nodes;
+#endif
+}
+
 U64 GetNps(int elapsed) {
 
     U64 nps = 0;
     if (elapsed) {
-        nps = (Glob.nodes * 1000) / elapsed;
+        nps = (GetNodes() * 1000) / elapsed;
     }
     return nps;
 }
@@ -1114,7 +1354,8 @@ void cEngine::DisplayPv(int multipv, int score, int *pv) {
     const char *type; 
     char pvString[512];
     int elapsed = GetMS() - msStartTime;
-    U64 nps = GetNps(elapsed);
+    U64 nodes = GetNodes();
+    U64 nps = elapsed ? (nodes * 1000) / elapsed : 0;
 
     type = "mate";
     if (score < -MAX_EVAL)
@@ -1127,13 +1368,15 @@ void cEngine::DisplayPv(int multipv, int score, int *pv) {
     PvToStr(pv, pvString);
 
     if (multipv == 0)
-        printf("info depth %d time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
-                mRootDepth, elapsed, (U64)Glob.nodes, nps, type, score, pvString);
+        printf("info depth %d time %d nodes %" PRIu64 " nps %" PRIu64 " hashfull %d score %s %d pv %s\n",
+                mRootDepth, elapsed, nodes, nps, Trans.Hashfull(), type, score, pvString);
     else
-        printf("info depth %d multipv %d time %d nodes %" PRIu64 " nps %" PRIu64 " score %s %d pv %s\n",
-                mRootDepth, multipv, elapsed, (U64)Glob.nodes, nps, type, score, pvString);
+        printf("info depth %d multipv %d time %d nodes %" PRIu64 " nps %" PRIu64 " hashfull %d score %s %d pv %s\n",
+                mRootDepth, multipv, elapsed, nodes, nps, Trans.Hashfull(), type, score, pvString);
 }
 
+#ifndef USE_THREADS
+
 void CheckTimeout() {
 
     char command[80];
@@ -1161,12 +1404,17 @@ void CheckTimeout() {
         Glob.abortSearch = true;
 }
 
+#endif
+
 void cEngine::Slowdown() {
 
-    // Handling search limited by the number of nodes
+    // Handling search limited by the number of nodes. With more than one
+    // thread the total is summed only every 1024 nodes, so that threads
+    // don't keep reading each other's counters.
 
     if (msMoveNodes > 0) {
-        if (Glob.nodes >= (unsigned)msMoveNodes)
+        if ((Glob.thread_no == 1 || !(mNodes & 1023))
+        &&  GetNodes() >= (unsigned)msMoveNodes)
             Glob.abortSearch = true;
     }
 
@@ -1188,22 +1436,13 @@ void cEngine::Slowdown() {
 
     // If Rodent is compiled as a single-threaded engine, Slowdown()
     // function assumes additional role and enforces time control
-    // handling.
+    // handling. The threaded build reads input on a separate thread.
 
 #ifndef USE_THREADS
-    if ((!(Glob.nodes & 2047))
-    && !Glob.is_testing
+    if ((!(mNodes & 2047))
+    && !Glob.isTesting
     &&   mRootDepth > 1) CheckTimeout();
 #endif
-
-    // for MultiPv
-
-    if (Glob.multiPv > 1) {
-        if ((!(Glob.nodes & 2047))
-        && !Glob.isTesting
-        &&   mRootDepth > 1) CheckTimeout();
-    }
-
 }
 
 int POS::DrawScore() const {
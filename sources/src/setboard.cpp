@@ -110,4 +110,6 @@ void POS::SetPosition(const char *epd) {
     }
     InitHashKey();
     InitPawnKey();
+    InitMaterialKey();
+    InitCheckInfo();
 }
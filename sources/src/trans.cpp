@@ -20,147 +20,442 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include <cstring>
 
-#if defined(USE_THREADS)
-    #include <atomic>
-    #include <memory>
+#if defined(__linux__)
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+    #ifndef MPOL_INTERLEAVE
+        #define MPOL_INTERLEAVE 3
+    #endif
+#endif
 
-    // TODO: see if we get a slowdown by making all these class methods
+ChessHeapClass Trans;
 
-    std::unique_ptr<std::atomic_flag[]> aflags0;
-    std::unique_ptr<std::atomic_flag[]> aflags1;
-    const unsigned int elem_per_aflag = 4;
+#if defined(__linux__)
 
-    #define LOCK_ME_PLEASE0   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag; while (aflags0[current_aflag].test_and_set(std::memory_order_acquire));
-    #define UNLOCK_ME_PLEASE0 aflags0[current_aflag].clear(std::memory_order_release)
-    #define LOCK_ME_PLEASE1   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag; while (aflags1[current_aflag].test_and_set(std::memory_order_acquire));
-    #define UNLOCK_ME_PLEASE1 aflags1[current_aflag].clear(std::memory_order_release)
+// Bitmask of online NUMA nodes, read from sysfs (e.g. "0-1" or "0,2-3").
+// Returns 0 if it can't be read, which means a non-NUMA kernel.
 
-    #define LOCK_ME_PLEASE01   const unsigned int current_aflag = (key & tt_mask) / elem_per_aflag;\
-                               while (aflags0[current_aflag].test_and_set(std::memory_order_acquire));\
-                               while (aflags1[current_aflag].test_and_set(std::memory_order_acquire));
+static unsigned long OnlineNumaNodes() {
 
-#else
-    #define LOCK_ME_PLEASE0
-    #define UNLOCK_ME_PLEASE0
-    #define LOCK_ME_PLEASE1
-    #define UNLOCK_ME_PLEASE1
+    int nodes[64];
+    unsigned long mask = 0;
+    const int count = ReadSysList("/sys/devices/system/node/online", nodes, 64);
 
-    #define LOCK_ME_PLEASE01
+    for (int i = 0; i < count; i++)
+        if (nodes[i] < 64) mask |= 1UL << nodes[i];
+    return mask;
+}
 
-#endif
+static bool TransparentHugePagesEnabled() {
 
-ChessHeapClass Trans;
+    char line[128];
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    bool result = false;
 
-void ChessHeapClass::AllocTrans(unsigned int mbsize) {
+    if (f == NULL) return false;
+    if (fgets(line, sizeof(line), f))
+        result = strstr(line, "[never]") == NULL;
+    fclose(f);
+    return result;
+}
 
-    static unsigned int prev_size;
+// Linux allocation: one mmap() of the whole table, backed by explicit huge pages
+// if the administrator has reserved them, otherwise by transparent huge pages.
+// Either way random probes of a big hash cause far fewer TLB misses than with
+// 4KB pages. On a NUMA machine the pages are either interleaved across nodes or
+// left to the first-touch policy (each page lands on the node of the thread that
+// clears it first).
+
+bool ChessHeapClass::MapPages(int size_mb) {
+
+    // A hugetlbfs mapping must be a whole number of huge pages, or munmap()
+    // of it fails, so an odd size in megabytes is rounded up to 2MB
+
+    const size_t huge_page = 2 * 1024 * 1024;
+    size_t size = ((size_t)size_mb * 1024 * 1024 + huge_page - 1) & ~(huge_page - 1);
+    const char *pages = "2MB pages (hugetlbfs)";
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (mem == MAP_FAILED) {
+        size = (size_t)size_mb * 1024 * 1024;
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+            return false;
+        if (madvise(mem, size, MADV_HUGEPAGE) == 0 && TransparentHugePagesEnabled())
+            pages = "transparent huge pages";
+        else
+            pages = "4KB pages";
+    }
 
-    for (tt_size = 2; tt_size <= mbsize; tt_size *= 2)
-        ;
+    snprintf(mem_mode, sizeof(mem_mode), "%s, %s", pages, PlacePages(mem, size));
 
-    tt_size /= 2;
+    map_size = size;
+    table = (sTTCluster *)mem;
 
-    if (prev_size != tt_size) { // don't waste time if the size is the same
+    return true;
+}
 
-        if (!Alloc(tt_size)) {
-            if (Glob.is_noisy)
-                printf("info string memory allocation error\n");
-            prev_size = 0; // will realloc next time
-            return;
-        }
+const char *ChessHeapClass::PlacePages(void *mem, size_t size) const {
 
-        prev_size = tt_size;
+    const unsigned long nodes = OnlineNumaNodes();
 
-        tt_size = tt_size * (1024 * 1024 / sizeof(ENTRY)); // number of elements of type ENTRY
-        tt_mask = tt_size - 4;
-        //printf("info string ttsize %ull\n", tt_size);
+    if (!(nodes & (nodes - 1)))
+        return "single NUMA node";
+    if (mem_policy == MEM_FIRST_TOUCH)
+        return "first-touch NUMA placement";
+    if (syscall(SYS_mbind, mem, size, MPOL_INTERLEAVE, &nodes, 8 * sizeof(nodes) + 1, 0) == 0)
+        return "interleaved across NUMA nodes";
+    return "NUMA interleave failed, default placement";
+}
 
-#if defined(USE_THREADS)
-        unsigned int number_of_aflags = tt_size / 4;
+// Shared allocation: the table is the POSIX shared memory object named after
+// the `Shared Hash` option and the size of the table, so that engines on one
+// machine set to the same name and size use a single table. Entries are
+// written without locks anyway, so nothing changes for the search. The first
+// engine creates the object; the others attach to it and keep its contents.
+// The object outlives the engines (it can be removed from /dev/shm), except
+// that an engine which created it removes its name when switching to another
+// size or name, so that resizing doesn't leave stale tables behind. One more
+// cache line after the clusters holds the search counter that dates entries,
+// so that the entries of one engine don't look stale to the others.
 
-        aflags0 = std::make_unique<std::atomic_flag[]> (number_of_aflags);
-        aflags1 = std::make_unique<std::atomic_flag[]> (number_of_aflags);
+bool ChessHeapClass::MapShared(int size_mb) {
 
-        for (unsigned int i = 0; i < number_of_aflags; i++) {
-            aflags0[i].clear(std::memory_order_relaxed);
-            aflags1[i].clear(std::memory_order_relaxed);
-        }
-#endif
+    char object[sizeof(shm_object)];
+    const size_t size = (size_t)size_mb * 1024 * 1024 + sizeof(sTTCluster);
+    bool created = true;
+
+    snprintf(object, sizeof(object), "/%s-%dMB", shm_name, size_mb);
+
+    int fd = shm_open(object, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (fd < 0) {
+        created = false;
+        fd = shm_open(object, O_RDWR, 0600);
+    }
+
+    if (fd < 0)
+        return false;
+
+    // an engine that attaches right after the object was created may set the
+    // size before its creator does; that is harmless, as both set the same one
+
+    void *mem = ftruncate(fd, (off_t)size) == 0
+              ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        if (created) shm_unlink(object);
+        return false;
+    }
+
+    madvise(mem, size, MADV_HUGEPAGE);
+    snprintf(mem_mode, sizeof(mem_mode), "shared memory %s (%s), %s", object, created ? "created" : "attached", PlacePages(mem, size));
+    snprintf(shm_object, sizeof(shm_object), "%s", object);
+    shm_owner = created;
+
+    map_size = size;
+    table = (sTTCluster *)mem;
+    shm_date = (std::atomic<int> *)((char *)mem + size - sizeof(sTTCluster));
+
+    return true;
+}
+
+void ChessHeapClass::SetShared(const char *name) {
+
+    if (strcmp(name, "<empty>") == 0) name = "";
+    if (strcmp(name, shm_name) == 0) return;
+
+    if (strlen(name) >= sizeof(shm_name) || strchr(name, '/')) {
+        printf("info string invalid shared hash name\n");
+        return;
     }
 
-    Clear();
+    char old_name[sizeof(shm_name)];
+
+    memcpy(old_name, shm_name, sizeof(shm_name));
+    snprintf(shm_name, sizeof(shm_name), "%s", name);
+
+    if (!Resize(Max(1u, prev_size)))
+        memcpy(shm_name, old_name, sizeof(shm_name));
+}
+
+void ChessHeapClass::Release(sTTCluster *mapped, void *mem, size_t mapped_size) {
+
+    if (mapped_size && munmap(mapped, mapped_size) != 0)
+        printf("info string munmap of %zu bytes failed: %s\n", mapped_size, strerror(errno));
+    free(mem);
+}
+
+#else
+
+bool ChessHeapClass::MapPages(int) {
+
+    return false;
+}
+
+bool ChessHeapClass::MapShared(int) {
+
+    return false;
+}
+
+void ChessHeapClass::SetShared(const char *) {}
+
+void ChessHeapClass::Release(sTTCluster *, void *mem, size_t) {
+
+    free(mem);
+}
+
+#endif
+
+void ChessHeapClass::SetMemPolicy(int policy) {
+
+    if (policy == mem_policy) return;
+
+    mem_policy = policy;
+    if (prev_size && !shm_name[0]) Resize(prev_size);
+}
+
+void ChessHeapClass::AllocTrans(unsigned int mbsize) {
+
+    const unsigned int size_mb = Max(1u, mbsize); // any size will do, see ClusterOf()
 
-    if (Glob.is_noisy)
+    if (prev_size == size_mb) return; // don't waste time if the size is the same
+
+    Resize(size_mb);
+
+    if (Glob.is_noisy && prev_size == size_mb)
         printf("info string %uMB of memory allocated\n", prev_size);
 }
 
+// Allocates a table of size_mb megabytes and moves the entries of the current
+// table into it, so that changing the hash size doesn't throw away the results
+// of a long analysis. Both tables exist at the same time; if there is not
+// enough memory for that, the current table is kept. A shared table that
+// other engines have already created is used as it is.
+
+bool ChessHeapClass::Resize(unsigned int size_mb) {
+
+    sTTCluster *old_table = table;
+    void *old_mem = table_mem;
+    const size_t old_map_size = map_size;
+    const U64 old_size = success ? tt_size : 0;
+    char old_mode[sizeof(mem_mode)], old_object[sizeof(shm_object)];
+    const bool old_owner = shm_owner;
+    std::atomic<int> *old_date = shm_date;
+
+    memcpy(old_mode, mem_mode, sizeof(mem_mode));
+    memcpy(old_object, shm_object, sizeof(shm_object));
+    shm_object[0] = '\0';
+    shm_owner = false;
+    table = NULL;
+    table_mem = NULL;
+    map_size = 0;
+    shm_date = NULL;
+
+    if (!Alloc(size_mb)) {
+        table = old_table;
+        table_mem = old_mem;
+        map_size = old_map_size;
+        shm_date = old_date;
+        if (success)
+            memcpy(mem_mode, old_mode, sizeof(mem_mode));
+        else
+            snprintf(mem_mode, sizeof(mem_mode), "allocation of %uMB failed", size_mb);
+        memcpy(shm_object, old_object, sizeof(shm_object));
+        shm_owner = old_owner;
+        if (Glob.is_noisy)
+            printf("info string memory allocation error\n");
+        return false;
+    }
+
+    prev_size = size_mb;
+    tt_size = (U64)size_mb * (1024 * 1024 / sizeof(sTTCluster)); // number of clusters
+
+    if (!success) tt_date = 0;
+    success = true;
+
+    if (shm_owner)
+        shm_date->store(tt_date); // the entries moved in below keep their dates
+    else if (shm_date)
+        tt_date = shm_date->load() & 255;
+
+    if (!shm_object[0] || shm_owner)
+        Rebuild(old_table, old_size);
+    Release(old_table, old_mem, old_map_size);
+#if defined(__linux__)
+    if (old_owner)
+        shm_unlink(old_object);
+#endif
+    return true;
+}
+
 void ChessHeapClass::Clear() {
 
     tt_date = 0;
+    if (shm_date) shm_date->store(0);
 
-    ZeroMem();
+    Rebuild(NULL, 0);
 }
 
-bool ChessHeapClass::Retrieve(U64 key, int *move, int *score, int *flag, int alpha, int beta, int depth, int ply) {
+// Called at the start of each search. Engines sharing a table take their
+// dates from one counter, so a search by any of them ages all entries alike.
 
-    if (!success) return false;
+void ChessHeapClass::NewSearch() {
 
-    ENTRY *entry = MakeAddr(key & tt_mask);
-
-    LOCK_ME_PLEASE0;
-
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            entry->date = tt_date;
-            *move = entry->move;
-            if (entry->depth >= depth) {
-				*flag = entry->flags;
-                *score = entry->score;
-                if (*score < -MAX_EVAL)
-                    *score += ply;
-                else if (*score > MAX_EVAL)
-                    *score -= ply;
-                if ((entry->flags & UPPER && *score <= alpha)
-                || (entry->flags & LOWER && *score >= beta)) {
-                    //entry->date = tt_date; // refreshing entry TODO: test at 4 threads, at 1 thread it's a wash
-
-                    UNLOCK_ME_PLEASE0;
-                    return true;
-                }
-            }
-            break;
-        }
-        entry++;
+    tt_date = shm_date ? (shm_date->fetch_add(1) + 1) & 255 : (tt_date + 1) & 255;
+}
+
+// Clearing a multi-gigabyte table on one thread takes seconds, so the table is
+// split into one slice per search thread (but no slice smaller than 32MB) and
+// each slice is cleared, and filled with the entries of the old table that
+// belong to it, by the worker thread of the corresponding engine.
+
+void ChessHeapClass::Rebuild(const sTTCluster *old_table, U64 old_size) {
+
+    if (!success) return;
+
+#ifdef USE_THREADS
+    const int threads = Max(1, Min((int)Engines.size(), (int)(prev_size / 32)));
+    const U64 slice = tt_size / threads;
+    int i = 0;
+
+    for (auto& engine : Engines) {
+        const U64 first = i * slice;
+        const U64 last = i == threads - 1 ? tt_size : first + slice;
+        engine.StartTask([this, first, last, old_table, old_size] { RebuildClusters(first, last, old_table, old_size); });
+        if (++i == threads) break;
     }
 
-    UNLOCK_ME_PLEASE0;
-    return false;
+    for (auto& engine : Engines)
+        engine.WaitTask();
+#else
+    RebuildClusters(0, tt_size, old_table, old_size);
+#endif
 }
 
-void ChessHeapClass::RetrieveMove(U64 key, int *move) {
+// The position of an old entry, in clusters of the new table, is estimated
+// from its old cluster and the five position bits stored with it. That is
+// exact when shrinking and when growing up to 32 times, barring rounding.
+// Each thread scans the old clusters that overlap its slice and skips the
+// entries that land outside of it, so no two threads write to one cluster.
+// The key bits of an entry are recovered with the check of its old position
+// bits; if a racing store left these wrong, the entry can't be told apart from
+// a valid one, but it goes on failing its check and is never found.
 
-    if (!success) return;
+void ChessHeapClass::RebuildClusters(U64 first, U64 last, const sTTCluster *old_table, U64 old_size) {
+
+    memset((void *)MakeAddr(first), 0, (size_t)(last - first) * sizeof(sTTCluster));
+
+    if (!old_size) return;
+
+    const double ratio = (double)tt_size / old_size;
+    const U64 from = (U64)(first / ratio);
+    const U64 to = Min(old_size, (U64)(last / ratio) + 2);
 
-    ENTRY *entry = MakeAddr(key & tt_mask);
+    for (U64 c = from ? from - 1 : 0; c < to; c++) {
+        const sTTCluster *cluster = old_table + c;
+        const uint32_t pos = cluster->pos.load(std::memory_order_relaxed);
+        for (int i = 0; i < cluster_entries; i++) {
+            U64 data = cluster->data[i].load(std::memory_order_relaxed);
+            if (DataFlags(data) == NONE) continue;
 
-    LOCK_ME_PLEASE1;
+            const double where = (c + (EntryPos(pos, i) + 0.5) / 32) * ratio;
+            const U64 n = Min((U64)where, tt_size - 1);
+            if (n < first || n >= last) continue;
 
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            entry->date = tt_date; // TODO: test without this line (very low priority, long test)
-            *move = entry->move;
+            Insert(MakeAddr(n), cluster->key[i].load(std::memory_order_relaxed) ^ DataCheck(data, EntryPos(pos, i)), data, Min(31u, (unsigned)((where - n) * 32)));
+        }
+    }
+}
+
+// Puts an entry into an empty slot of the cluster or, if there is none, in
+// place of the stalest entry if that one is staler. When shrinking, the
+// deepest and newest entries mapped to a cluster are the ones that survive.
+
+void ChessHeapClass::Insert(sTTCluster *cluster, uint16_t fragment, U64 data, unsigned pos) const {
+
+    int replace = -1, worst = Staleness(data);
+
+    for (int i = 0; i < cluster_entries; i++) {
+        const U64 old = cluster->data[i].load(std::memory_order_relaxed);
+        if (DataFlags(old) == NONE) {
+            replace = i;
             break;
         }
-        entry++;
+        if (Staleness(old) > worst) {
+            worst = Staleness(old);
+            replace = i;
+        }
     }
 
-    UNLOCK_ME_PLEASE1;
+    if (replace < 0) return;
+
+    cluster->data[replace].store(data, std::memory_order_relaxed);
+    cluster->key[replace].store(fragment ^ DataCheck(data, pos), std::memory_order_relaxed);
+    SetEntryPos(cluster, replace, pos);
 }
 
-void ChessHeapClass::Store(U64 key, int move, int score, int flags, int depth, int ply) {
+// Copies the entry of a position, so that the search can make all its hash
+// table decisions at a node from a single probe. Returns false (and an entry
+// with no move, no bound and no eval) if the position is not in the table.
+
+bool ChessHeapClass::Probe(U64 key, int ply, sHashEntry *entry) {
+
+    entry->move = 0;
+    entry->score = -INF;
+    entry->eval = NO_EVAL;
+    entry->depth = -1;
+    entry->flags = NONE;
+
+    if (!success) return false;
+
+    sTTCluster *cluster = ClusterOf(key);
+    U64 data;
+    int i = FindEntry(cluster, key, &data);
+
+    if (i < 0) return false;
+
+    RefreshEntry(cluster, i, data);
+    entry->move = DataMove(data);
+    entry->score = DataScore(data);
+    entry->eval = DataEval(data);
+    entry->depth = DataDepth(data);
+    entry->flags = DataFlags(data);
+
+    if (entry->score < -MAX_EVAL)
+        entry->score += ply;
+    else if (entry->score > MAX_EVAL)
+        entry->score -= ply;
+
+    return true;
+}
+
+void ChessHeapClass::RetrieveMove(U64 key, int *move) {
 
     if (!success) return;
 
+    sTTCluster *cluster = ClusterOf(key);
+    U64 data;
+    int i = FindEntry(cluster, key, &data);
+
+    if (i >= 0) {
+        RefreshEntry(cluster, i, data); // TODO: test without this line (very low priority, long test)
+        *move = DataMove(data);
+    }
+}
+
+eHashStore ChessHeapClass::Store(U64 key, int move, int score, int eval, int flags, int depth, int ply) {
+
+    if (!success) return STORE_NONE;
+
+    eHashStore result = STORE_SAME;
+
     int oldest = -1, age;
 
     if (score < -MAX_EVAL)
@@ -168,27 +463,420 @@ void ChessHeapClass::Store(U64 key, int move, int score, int flags, int depth, i
     else if (score > MAX_EVAL)
         score += ply;
 
-    ENTRY *entry = MakeAddr(key & tt_mask), *replace = NULL;
+    sTTCluster *cluster = ClusterOf(key);
+    U64 data;
+    int replace = FindEntry(cluster, key, &data);
+
+    if (replace >= 0) {
+        if (!move) move = DataMove(data);
+        if (eval == NO_EVAL) eval = DataEval(data);
+    } else {
+        for (int i = 0; i < cluster_entries; i++) {
+            data = cluster->data[i].load(std::memory_order_relaxed);
+            age = Staleness(data);
+            if (age > oldest) {
+                oldest = age;
+                replace = i;
+            }
+        }
+
+        data = cluster->data[replace].load(std::memory_order_relaxed);
+        if (DataFlags(data) == NONE)                 result = STORE_EMPTY;
+        else if (DataDate(data) != (tt_date & 63))   result = STORE_OLD;
+        else                                         result = STORE_LIVE;
+    }
 
-    for (int i = 0; i < 4; i++) {
-        if (entry->key == key) {
-            if (!move) move = entry->move;
-            replace = entry;
-            break;
+    data = PackData(move, score, eval, depth, flags, tt_date);
+    cluster->data[replace].store(data, std::memory_order_relaxed);
+    const unsigned pos = KeyPos(key, tt_size);
+    cluster->key[replace].store(KeyFragment(key) ^ DataCheck(data, pos), std::memory_order_relaxed);
+    SetEntryPos(cluster, replace, pos);
+    return result;
+}
+
+// Permille of entries used by the current search, sampled from the first
+// clusters of the table (for `info hashfull`)
+
+int ChessHeapClass::Hashfull() const {
+
+    if (!success) return 0;
+
+    const int clusters = (int)Min(tt_size, (U64)(1000 / cluster_entries + 1));
+    int used = 0;
+
+    for (int c = 0; c < clusters; c++) {
+        const sTTCluster *cluster = MakeAddr(c);
+        for (int i = 0; i < cluster_entries; i++) {
+            U64 data = cluster->data[i].load(std::memory_order_relaxed);
+            if (DataFlags(data) != NONE && DataDate(data) == (tt_date & 63))
+                used++;
         }
-        age = ((tt_date - entry->date) & 255) * 256 + 255 - entry->depth;
-        if (age > oldest) {
-            oldest = age;
-            replace = entry;
+    }
+
+    return (used * 1000) / (clusters * cluster_entries);
+}
+
+// `hashstats` console command: distribution of entries by age (in searches)
+// and by depth, from a sample of up to 2^20 clusters spread over the table,
+// and how stores used their slots since the table was last cleared
+
+void ChessHeapClass::PrintStats() const {
+
+    if (!success) {
+        printf("info string no hash table allocated\n");
+        return;
+    }
+
+    const U64 step = Max((U64)1, tt_size >> 20);
+    U64 ages[64] = {}, depths[256] = {};
+    U64 sampled = 0, used = 0;
+
+    for (U64 c = 0; c < tt_size; c += step) {
+        const sTTCluster *cluster = MakeAddr(c);
+        for (int i = 0; i < cluster_entries; i++) {
+            U64 data = cluster->data[i].load(std::memory_order_relaxed);
+            sampled++;
+            if (DataFlags(data) == NONE) continue;
+            used++;
+            ages[(tt_date - DataDate(data)) & 63]++;
+            depths[DataDepth(data)]++;
         }
-        entry++;
     }
 
-    LOCK_ME_PLEASE01;
+    U64 stores[STORE_RESULTS] = {};
+#ifndef USE_THREADS
+    for (int r = 0; r < STORE_RESULTS; r++)
+        stores[r] += EngineSingle.mHashStores[r];
+#else
+    for (auto& engine : Engines)
+        for (int r = 0; r < STORE_RESULTS; r++)
+            stores[r] += engine.mHashStores[r];
+#endif
+
+    printf("hash: %uMB, %" PRIu64 " clusters of %d entries, %s\n", prev_size, tt_size, cluster_entries, mem_mode);
+    printf("sampled %" PRIu64 " entries, %" PRIu64 " used (%.1f%%), hashfull %d\n",
+           sampled, used, 100.0 * used / sampled, Hashfull());
+
+    printf("age (searches ago):");
+    for (int a = 0; a < 64; a++)
+        if (ages[a]) printf(" %d:%.1f%%", a, 100.0 * ages[a] / used);
+    printf("\n");
+
+    printf("depth:");
+    for (int d = 0; d < 256; d++)
+        if (depths[d]) printf(" %d:%.1f%%", d, 100.0 * depths[d] / used);
+    printf("\n");
+
+    printf("stores: %" PRIu64 " same position, %" PRIu64 " empty slot, %" PRIu64 " older search, %" PRIu64 " current search\n",
+           stores[STORE_SAME], stores[STORE_EMPTY], stores[STORE_OLD], stores[STORE_LIVE]);
+}
+
+// `savehash` / `loadhash` console commands. The file is a 64-byte header and
+// the clusters of the table as they are in memory, so it is only portable
+// between builds with the same entry layout (checked by the version number)
+// and byte order. A table of any size can be loaded: its entries are moved
+// into the current table by Rebuild(), like on a resize.
+
+static constexpr char hash_file_magic[8] = { 'R', 'o', 'd', 'e', 'n', 't', 'T', 'T' };
+static constexpr uint32_t hash_file_version = 3;
+
+struct sHashFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t cluster_size;
+    U64 clusters;
+    int32_t date;
+    char padding[36];
+};
+
+static_assert(sizeof(sHashFileHeader) == sizeof(sTTCluster), "the clusters of a hash file must stay aligned");
+
+void ChessHeapClass::Save(const char *file_name) const {
+
+    if (!success) {
+        printf("info string no hash table allocated\n");
+        return;
+    }
+
+    FILE *f = fopen(file_name, "wb");
+
+    if (f == NULL) {
+        printf("info string cannot create %s\n", file_name);
+        return;
+    }
+
+    sHashFileHeader header = {};
+    memcpy(header.magic, hash_file_magic, sizeof(header.magic));
+    header.version = hash_file_version;
+    header.cluster_size = sizeof(sTTCluster);
+    header.clusters = tt_size;
+    header.date = tt_date;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+           && fwrite((const void *)table, sizeof(sTTCluster), (size_t)tt_size, f) == tt_size;
+    ok = fclose(f) == 0 && ok;
+
+    if (ok)
+        printf("info string %" PRIu64 " clusters saved to %s\n", tt_size, file_name);
+    else
+        printf("info string error writing %s\n", file_name);
+}
+
+static bool ValidHashFile(const sHashFileHeader *header, U64 file_size) {
+
+    return memcmp(header->magic, hash_file_magic, sizeof(header->magic)) == 0
+        && header->version == hash_file_version
+        && header->cluster_size == sizeof(sTTCluster)
+        && header->clusters > 0
+        && file_size >= sizeof(sHashFileHeader)
+        && (file_size - sizeof(sHashFileHeader)) % sizeof(sTTCluster) == 0
+        && (file_size - sizeof(sHashFileHeader)) / sizeof(sTTCluster) == header->clusters; // no overflow
+}
+
+#if defined(__linux__)
+
+// The file is mapped rather than read, so the worker threads of Rebuild()
+// page in their own parts of it at the same time.
+
+void ChessHeapClass::Load(const char *file_name) {
+
+    if (!success) {
+        printf("info string no hash table allocated\n");
+        return;
+    }
+
+    struct stat st;
+    const int fd = open(file_name, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(sHashFileHeader)) {
+        printf("info string cannot read %s\n", file_name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    void *mem = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mem == MAP_FAILED) {
+        printf("info string cannot map %s\n", file_name);
+        return;
+    }
+
+    const sHashFileHeader *header = (const sHashFileHeader *)mem;
+
+    if (ValidHashFile(header, (U64)st.st_size)) {
+        madvise(mem, (size_t)st.st_size, MADV_WILLNEED);
+        tt_date = header->date;
+        if (shm_date) shm_date->store(tt_date);
+        Rebuild((const sTTCluster *)(header + 1), header->clusters);
+        printf("info string %" PRIu64 " clusters loaded from %s\n", header->clusters, file_name);
+    } else
+        printf("info string %s is not a hash file of this version\n", file_name);
+
+    munmap(mem, (size_t)st.st_size);
+}
+
+#else
+
+// Length of the file in bytes (64-bit even where long is not), or -1; the file
+// is left positioned at its start
+
+static long long HashFileSize(FILE *f) {
+
+#if defined(_WIN32)
+    const long long size = _fseeki64(f, 0, SEEK_END) == 0 ? _ftelli64(f) : -1;
+    return _fseeki64(f, 0, SEEK_SET) == 0 ? size : -1;
+#else
+    const long long size = fseeko(f, 0, SEEK_END) == 0 ? (long long)ftello(f) : -1;
+    return fseeko(f, 0, SEEK_SET) == 0 ? size : -1;
+#endif
+}
+
+void ChessHeapClass::Load(const char *file_name) {
+
+    if (!success) {
+        printf("info string no hash table allocated\n");
+        return;
+    }
+
+    FILE *f = fopen(file_name, "rb");
+    sHashFileHeader header;
+    const long long file_size = f ? HashFileSize(f) : -1;
+
+    if (f == NULL || file_size < 0 || fread(&header, sizeof(header), 1, f) != 1) {
+        printf("info string cannot read %s\n", file_name);
+        if (f) fclose(f);
+        return;
+    }
+
+    // the cluster count is checked against the file length, and against the
+    // address space, before anything is allocated
+    const size_t clusters = (size_t)header.clusters;
+    sTTCluster *file_table = ValidHashFile(&header, (U64)file_size)
+                          && header.clusters < SIZE_MAX / sizeof(sTTCluster) - 1
+                           ? (sTTCluster *)malloc(clusters * sizeof(sTTCluster) + sizeof(sTTCluster)) : NULL;
+    sTTCluster *aligned = (sTTCluster *)(((uintptr_t)file_table + sizeof(sTTCluster) - 1) & ~(uintptr_t)(sizeof(sTTCluster) - 1));
+
+    if (file_table && fread((void *)aligned, sizeof(sTTCluster), clusters, f) == clusters) {
+        tt_date = header.date;
+        if (shm_date) shm_date->store(tt_date);
+        Rebuild(aligned, header.clusters);
+        printf("info string %" PRIu64 " clusters loaded from %s\n", header.clusters, file_name);
+    } else
+        printf("info string %s is not a hash file of this version\n", file_name);
+
+    free(file_table);
+    fclose(f);
+}
+
+#endif
+
+// `hashtest [threads]` console command: several threads store and probe the
+// positions of random games in a table of 1MB, small enough for entries to be
+// replaced all the time, and each hit is checked against what was stored for
+// its position. Positions that share a cluster and 16 key bits with another
+// one are left out, so a hit with the wrong data can only be an entry that was
+// torn by a concurrent store, or one that belongs to another position.
+
+struct sHashSample {
+    U64 key;
+    int move; // a legal move in the position
+};
+
+static U64 HashTestRandom(U64 *state) { // xorshift64
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int HashTestSamples(sHashSample *samples, int count, U64 seed) {
+
+    POS p[1];
+    UNDO u[1];
+    int list[MAX_MOVES], legal[MAX_MOVES];
+    int n = 0;
+
+    while (n < count) {
+        p->SetPosition(START_POS);
+        for (int ply = 0; ply < 100 && n < count; ply++) {
+            int *last = p->GenerateQuiet(p->GenerateCaptures(list));
+            int moves = 0;
+
+            for (int *move = list; move < last; move++) {
+                if (!p->Legal(*move)) continue;
+                p->DoMove(*move, u);
+                if (!p->Illegal()) legal[moves++] = *move;
+                p->UndoMove(*move, u);
+            }
+
+            if (!moves) break;
+            samples[n].key = p->mHashKey;
+            samples[n].move = legal[HashTestRandom(&seed) % moves];
+            p->DoMove(samples[n++].move, u);
+        }
+    }
+
+    return n;
+}
+
+static int HashTestCompare(const void *a, const void *b) {
+
+    const U64 x = *(const U64 *)a, y = *(const U64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+void ChessHeapClass::StressTest(int threads) {
+
+    const int count = 1 << 18;   // about 2.7 positions per entry
+    const U64 ops = 4000000;     // per thread, half of them stores
+
+#ifdef USE_THREADS
+    threads = Max(1, Min(threads ? threads : 4, 64));
+#else
+    threads = 1;
+#endif
+
+    ChessHeapClass tt;
+    sHashSample *samples = (sHashSample *)malloc(count * sizeof(sHashSample));
+    U64 *tags = (U64 *)malloc(count * sizeof(U64));
+
+    if (!samples || !tags || !tt.Resize(1)) {
+        printf("info string hash test: memory allocation error\n");
+        free(samples);
+        free(tags);
+        return;
+    }
+
+    // Sort the positions by cluster and key bits and keep the first of each
+
+    int n = HashTestSamples(samples, count, 0x9E3779B97F4A7C15ULL);
+
+    for (int i = 0; i < n; i++)
+        tags[i] = (MulHi(samples[i].key, tt.tt_size) << 16 | KeyFragment(samples[i].key)) << 20 | (U64)i;
+    qsort(tags, n, sizeof(U64), HashTestCompare);
+
+    for (int i = 1; i < n; i++)
+        if (tags[i] >> 20 == tags[i - 1] >> 20)
+            samples[tags[i] & ((1 << 20) - 1)].move = 0;
+
+    int kept = 0;
+    for (int i = 0; i < n; i++)
+        if (samples[i].move)
+            samples[kept++] = samples[i];
+
+    // The data stored for a position is a function of its key
+
+    std::atomic<U64> probes{0}, hits{0}, bad{0};
+
+    auto hammer = [&](int thread) {
+        U64 seed = 0x2545F4914F6CDD1DULL * (thread + 1);
+        U64 my_probes = 0, my_hits = 0, my_bad = 0;
+        sHashEntry entry;
+
+        for (U64 op = 0; op < ops; op++) {
+            const sHashSample *sample = samples + HashTestRandom(&seed) % kept;
+            const U64 key = sample->key;
+            const int score = (int)(key >> 16 & 16383) - 8192;
+            const int eval = (int)(key >> 30 & 16383) - 8192;
+            const int depth = 1 + (int)(key >> 44 & 63) % (MAX_PLY - 1);
+            const int flags = 1 + (int)(key >> 50 & 1023) % 3;
+
+            if (op & 1) {
+                tt.Store(key, sample->move, score, eval, flags, depth, 0);
+                continue;
+            }
+
+            my_probes++;
+            if (!tt.Probe(key, 0, &entry)) continue;
+            my_hits++;
+            if (entry.move != sample->move || entry.score != score || entry.eval != eval
+            ||  entry.depth != depth || entry.flags != flags)
+                my_bad++;
+        }
+
+        probes += my_probes;
+        hits += my_hits;
+        bad += my_bad;
+    };
+
+    int start = GetMS();
+
+#ifdef USE_THREADS
+    std::thread workers[64];
+    for (int i = 0; i < threads; i++)
+        workers[i] = std::thread(hammer, i);
+    for (int i = 0; i < threads; i++)
+        workers[i].join();
+#else
+    hammer(0);
+#endif
 
-    replace->key = key; replace->date = tt_date; replace->move = move;
-    replace->score = score; replace->flags = flags; replace->depth = depth;
+    printf("info string hash test: %d threads, %d positions, %" PRIu64 " probes, %" PRIu64 " hits, %" PRIu64 " bad entries, %d ms\n",
+           threads, kept, probes.load(), hits.load(), bad.load(), GetMS() - start);
+    printf("info string hash test %s\n", bad.load() ? "FAILED" : "passed");
 
-    UNLOCK_ME_PLEASE0;
-    UNLOCK_ME_PLEASE1;
+    free(tags);
+    free(samples);
 }
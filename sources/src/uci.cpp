@@ -23,7 +23,8 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef USE_THREADS
     #include <thread>
-    using namespace std::literals::chrono_literals;
+    #include <deque>
+    #include <string>
 #endif
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -32,6 +33,8 @@ If not, see <http://www.gnu.org/licenses/>.
     #include <unistd.h>
 #endif
 
+#ifndef USE_THREADS
+
 void ReadLine(char *str, int n) {
 
     char *ptr;
@@ -42,6 +45,127 @@ void ReadLine(char *str, int n) {
         *ptr = '\0';
 }
 
+#else
+
+// Input is read by a dedicated thread that queues commands for UciLoop(). While
+// a search is running, `stop`, `ponderhit` and `quit` take effect at once (the
+// search only watches Glob.abortSearch) and `isready` is answered at once, so
+// the search never has to poll stdin. The same mutex and condition variable
+// let ParseGo() sleep until the deadline or until something happens.
+
+static std::mutex input_mutex;
+static std::condition_variable input_cond;
+static std::deque<std::string> input_queue;
+static bool search_active;      // guarded by input_mutex
+static int engines_running;     // guarded by input_mutex
+
+static bool HandleSearchCommand(const char *command) { // call with input_mutex held
+
+    if (strcmp(command, "stop") == 0)
+        Glob.abortSearch = true;
+    else if (strcmp(command, "ponderhit") == 0)
+        Glob.pondering = false;
+    else if (strcmp(command, "quit") == 0) {
+        Glob.abortSearch = true;
+        Glob.goodbye = true; // will crash if just `exit()`. should wait until threads are terminated
+    }
+    else if (strcmp(command, "isready") == 0)
+        printf("readyok\n");
+    else return false;
+
+    return true;
+}
+
+static void InputLoop() {
+
+    char command[4096], *ptr;
+
+    for (;;) {
+        if (fgets(command, sizeof(command), stdin) == NULL)
+            strcpy(command, "quit");
+        if ((ptr = strchr(command, '\n')) != NULL)
+            *ptr = '\0';
+
+        std::lock_guard<std::mutex> lock(input_mutex);
+
+        if (!search_active || !HandleSearchCommand(command))
+            input_queue.emplace_back(command);
+        input_cond.notify_all();
+
+        if (strcmp(command, "quit") == 0)
+            return;
+    }
+}
+
+void ReadLine(char *str, int n) {
+
+    static bool reader_started = false;
+
+    if (!reader_started) {
+        std::thread(InputLoop).detach(); // stops by itself after `quit`
+        reader_started = true;
+    }
+
+    std::unique_lock<std::mutex> lock(input_mutex);
+
+    input_cond.wait(lock, [] { return !input_queue.empty(); });
+    snprintf(str, n, "%s", input_queue.front().c_str());
+    input_queue.pop_front();
+}
+
+// Runs `search` on the worker threads of the first `count` engines and enforces
+// the time limit meanwhile, waking up only at the deadline, on a command from
+// the input thread or when an engine finishes.
+
+static void RunEngines(int count, std::function<void(cEngine *)> search) {
+
+    {
+        std::lock_guard<std::mutex> lock(input_mutex);
+        search_active = true;
+        engines_running = count;
+
+        // stop, ponderhit etc. that arrived right after `go` but before now
+        while (!input_queue.empty() && HandleSearchCommand(input_queue.front().c_str()))
+            input_queue.pop_front();
+    }
+
+    int i = 0;
+    for (auto& engine: Engines) {
+        if (i++ == count) break;
+        engine.StartTask([&engine, search] {
+            search(&engine);
+            std::lock_guard<std::mutex> lock(input_mutex);
+            engines_running--;
+            input_cond.notify_all();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(input_mutex);
+
+    while (engines_running > 0) {
+        if (!Glob.abortSearch && !Glob.pondering && !Glob.is_tuning && cEngine::msMoveTime >= 0) {
+            int time = cEngine::msMoveTime;
+            if (Glob.scoreJump && Glob.timeTricks) time *= 2;
+            const int left = time - (GetMS() - cEngine::msStartTime);
+            if (left <= 0)
+                Glob.abortSearch = true;
+            else
+                input_cond.wait_for(lock, std::chrono::milliseconds(left));
+        } else
+            input_cond.wait(lock);
+    }
+
+    search_active = false;
+    lock.unlock();
+
+    for (auto& engine: Engines)
+        engine.WaitTask();
+}
+
+static void ThreadBench(int depth, int threads);
+
+#endif
+
 const char *ParseToken(const char *string, char *token) {
 
     while (*string == ' ')
@@ -61,6 +185,7 @@ void UciLoop() {
     setbuf(stdout, NULL);
     p->SetPosition(START_POS);
     Trans.AllocTrans(16);
+    PawnHash.Alloc(PAWN_HASH_DEF_MB);
     for (;;) {
         ReadLine(command, sizeof(command));
         ptr = ParseToken(command, token);
@@ -75,7 +200,6 @@ void UciLoop() {
             PrintUciOptions();
             printf("uciok\n");
         } else if (strcmp(token, "ucinewgame") == 0) {
-            Trans.Clear();
             Glob.ClearData();
             p->SetPosition(START_POS);
             srand(GetMS());
@@ -110,12 +234,28 @@ void UciLoop() {
 #endif
             Glob.is_tuning = false;
 #endif
+        } else if (strcmp(token, "hashstats") == 0)  {
+            Trans.PrintStats();
+        } else if (strcmp(token, "savehash") == 0)   {
+            while (*ptr == ' ') ptr++;
+            Trans.Save(ptr);
+        } else if (strcmp(token, "loadhash") == 0)   {
+            while (*ptr == ' ') ptr++;
+            Trans.Load(ptr);
+        } else if (strcmp(token, "hashtest") == 0)   {
+            ptr = ParseToken(ptr, token);
+            ChessHeapClass::StressTest(atoi(token));
         } else if (strcmp(token, "bench") == 0)      {
             ptr = ParseToken(ptr, token);
 #ifndef USE_THREADS
             EngineSingle.Bench(atoi(token));
 #else
-            Engines.front().Bench(atoi(token));
+            int depth = atoi(token);
+            ptr = ParseToken(ptr, token);
+            if (atoi(token) > 1)
+                ThreadBench(depth, atoi(token));
+            else
+                Engines.front().Bench(depth);
 #endif
         } else if (strcmp(token, "quit") == 0)       {
             exit(0);
@@ -297,9 +437,10 @@ void ParseGo(POS *p, const char *ptr) {
     // set global variables
 
     cEngine::msStartTime = GetMS();
-    Trans.tt_date = (Trans.tt_date + 1) & 255;
-    Glob.nodes = 0;
+    Trans.NewSearch();
+    ResetNodes();
     Glob.abortSearch = false;
+    Glob.goodbye = false;
     Glob.depthReached = 0;
     if (Glob.shouldClear)
         Glob.ClearData(); // options has been changed and old tt scores are no longer reliable
@@ -325,53 +466,25 @@ void ParseGo(POS *p, const char *ptr) {
         }
     }
 
-    if (Glob.multiPv > 1) {
-
-        int pv[MAX_PLY];
-
-#ifndef USE_THREADS
-        EngineSingle.MultiPv(p, pv);
-#else
-        Engines.front().MultiPv(p, pv);
-#endif
-
-        if (Glob.goodbye)
-            exit(0);
-    }
-
-    if (Glob.multiPv == 1) {
-
     // Set engine-dependent variables and search using the designated number of threads
 
 #ifndef USE_THREADS
     EngineSingle.mDpCompleted = 0;
-    EngineSingle.Think(p);
+    if (Glob.multiPv > 1)
+        EngineSingle.MultiPv(p, EngineSingle.mPvEng);
+    else
+        EngineSingle.Think(p);
     ExtractMove(EngineSingle.mPvEng);
 #else
-    Glob.goodbye = false;
-
-	for (int i = 0; i < MAX_THREADS; i++) {
-		tDepth[i] = 0;
-	}
-
-    for (auto& engine: Engines) // mDpCompleted cleared in StartThinkThread();
-        engine.StartThinkThread(p);
-
-    std::thread timer([] {
-        while (Glob.abortSearch == false) {
-
-            // Check for timeout every 5 milliseconds. This allows Rodent
-            // to survive extreme time controls, like 1 s + 10 ms
-
-            std::this_thread::sleep_for(5ms);
-            if (!Glob.is_tuning) CheckTimeout();
-        }
-    });
-
-    for (auto& engine: Engines)
-        engine.WaitThinkThread();
+    for (auto& engine: Engines) {
+        engine.mIterDepth = 0;
+        engine.mDpCompleted = 0;
+    }
 
-    timer.join();
+    if (Glob.multiPv > 1)
+        RunEngines((int)Engines.size(), [p](cEngine *engine) { engine->MultiPv(p, engine->mPvEng); });
+    else
+        RunEngines((int)Engines.size(), [p](cEngine *engine) { engine->Think(p); });
 
     if (Glob.goodbye)
         exit(0);
@@ -386,53 +499,53 @@ void ParseGo(POS *p, const char *ptr) {
 
     ExtractMove(best_pv);
 #endif
-
-    }
-
 }
 
+static const char *bench_positions[] = {
+    "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
+    NULL
+}; // test positions taken from DiscoCheck by Lucas Braesch
+
 void cEngine::Bench(int depth) {
 
     POS p[1];
     int pv[MAX_PLY];
-    const char *test[] = {
-        "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",       // 1.e4 c5 2.Nf3 Nc6
-        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",   // multiple captures
-        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",                              // rook endgame
-        "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
-        "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",      // knight pseudo-sack
-        "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",  // pawn chain
-        "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
-        "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
-        "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",     // attack for pawn
-        "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",        // exchange sack
-        "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
-        "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",  // white pawn center
-        "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
-        "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
-        "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",         // endgame
-        "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",        // both queens en prise
-        NULL
-    }; // test positions taken from DiscoCheck by Lucas Braesch
 
     if (depth == 0) depth = 8; // so that you can call bench without parameters
     Trans.Clear();
+    PawnHash.Clear();
     ClearAll();
     mDpCompleted = 0; // maybe move to ClearAll()?
     Par.shut_up = true;
 
     printf("Bench test started (depth %d): \n", depth);
 
-    Glob.nodes = 0;
+    ResetNodes();
     Glob.abortSearch = false;
     msStartTime = GetMS();
+    msMoveTime = -1; // no time limit, whatever the last `go` command set
     msSearchDepth = depth;
 
     // search each position to desired depth
 
-    for (int i = 0; test[i]; ++i) {
-        printf("%s\n", test[i]);
-        p->SetPosition(test[i]);
+    for (int i = 0; bench_positions[i]; ++i) {
+        printf("%s\n", bench_positions[i]);
+        p->SetPosition(bench_positions[i]);
         Par.InitAsymmetric(p);
         Glob.depthReached = 0;
         Iterate(p, pv);
@@ -441,11 +554,84 @@ void cEngine::Bench(int depth) {
     // calculate and print statistics
 
     int end_time = GetMS() - msStartTime;
-    unsigned int nps = (unsigned int)((Glob.nodes * 1000) / (end_time + 1));
+    U64 nodes = GetNodes(); // as in the info lines
+    unsigned int nps = (unsigned int)((nodes * 1000) / (end_time + 1));
+
+    printf("%" PRIu64 " nodes searched in %d, speed %u nps (Score: %.3f)\n", nodes, end_time, nps, (float)nps / 430914.0);
+}
+
+#ifdef USE_THREADS
+
+// `bench [depth] [threads]` with more than one thread: searches the bench
+// positions the way `go depth` does, with all engines, to check that big thread
+// counts (64, 96, 128 and so on) run and reach the depth. The node count
+// depends on thread timing, so unlike single-thread bench it is no signature.
+// `stop` ends the test early; it then reports a failure.
+
+static void ThreadBench(int depth, int threads) {
 
-    printf("%" PRIu64 " nodes searched in %d, speed %u nps (Score: %.3f)\n", (U64)Glob.nodes, end_time, nps, (float)nps / 430914.0);
+    POS p[1];
+    const int old_threads = Glob.thread_no;
+    int short_of_depth = 0;
+    U64 nodes = 0;
+
+    if (depth == 0) depth = 8;
+    SetThreads(threads);
+    Trans.Clear();
+    Glob.ClearData();
+    Par.shut_up = true;
+
+    printf("Bench test started (depth %d, %d threads): \n", depth, Glob.thread_no);
+
+    cEngine::msMoveTime = -1;
+    cEngine::msMoveNodes = 0;
+    cEngine::msSearchDepth = depth;
+    Glob.goodbye = false;
+    int start_time = GetMS();
+
+    for (int i = 0; bench_positions[i]; ++i) {
+        printf("%s\n", bench_positions[i]);
+        p->SetPosition(bench_positions[i]);
+        Par.InitAsymmetric(p);
+
+        cEngine::msStartTime = GetMS();
+        Trans.NewSearch();
+        ResetNodes();
+        Glob.abortSearch = false;
+        Glob.depthReached = 0;
+        for (auto& engine: Engines) {
+            engine.mIterDepth = 0;
+            engine.mDpCompleted = 0;
+        }
+
+        RunEngines((int)Engines.size(), [&p](cEngine *engine) { engine->Think(p); });
+
+        if (Glob.goodbye)
+            exit(0);
+
+        int best_depth = 0, idle = 0;
+        for (auto& engine: Engines) {
+            best_depth = Max(best_depth, engine.mDpCompleted);
+            if (engine.mNodes == 0) idle++;
+        }
+
+        if (best_depth < depth) short_of_depth++;
+        nodes += GetNodes();
+        printf("info string depth %d, %" PRIu64 " nodes, %d of %d engines idle\n",
+               best_depth, GetNodes(), idle, (int)Engines.size());
+    }
+
+    int end_time = GetMS() - start_time;
+    unsigned int nps = (unsigned int)((nodes * 1000) / (end_time + 1));
+
+    printf("%" PRIu64 " nodes searched in %d, speed %u nps (%d threads)\n", nodes, end_time, nps, Glob.thread_no);
+    printf("info string thread bench %s\n", short_of_depth || Glob.thread_no != threads ? "FAILED" : "passed");
+
+    SetThreads(old_threads);
 }
 
+#endif
+
 void POS::PrintBoard() const {
 
     static const char piece_name[] = {'P', 'p', 'N', 'n', 'B', 'b', 'R', 'r', 'Q', 'q', 'K', 'k', '.' };
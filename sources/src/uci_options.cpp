@@ -40,9 +40,17 @@ void PrintUciOptions() {
 
 	printf("option name Clear Hash type button\n");
     printf("option name Hash type spin default 16 min 1 max %d\n", max_tt_size_mb);
+    printf("option name Pawn Hash type spin default %d min 1 max 1024\n", PAWN_HASH_DEF_MB);
+#if defined(__linux__)
+    printf("option name Hash Memory type combo default Interleave var Interleave var FirstTouch var Malloc\n");
+    printf("option name Shared Hash type string default <empty>\n");
+#endif
 #ifdef USE_THREADS
 	if (Glob.threadOverride == 0)
-    printf("option name Threads type spin default %d min 1 max %d\n", Glob.thread_no, MAX_THREADS);
+    printf("option name Threads type spin default %d min 1 max %d\n", Glob.thread_no, MaxThreads());
+#if defined(__linux__)
+    printf("option name Thread Binding type combo default None var None var Cores var Nodes\n");
+#endif
 #endif
     printf("option name MultiPV type spin default %d min 1 max %d\n", Glob.multiPv, MAX_PV);
 	printf("option name TimeBuffer type spin default %d min 0 max 1000\n", Glob.time_buffer);
@@ -172,16 +180,25 @@ void ParseSetoption(const char *ptr) {
 
     if (strcmp(name, "hash") == 0)                                           {
         Trans.AllocTrans(atoi(value));
+        printf("info string hash memory: %s\n", Trans.MemMode());
+    } else if (strcmp(name, "pawn hash") == 0)                               {
+        PawnHash.Alloc(Max(1, Min(atoi(value), 1024)));
+    } else if (strcmp(name, "hash memory") == 0)                             {
+        if (strcmp(value, "FirstTouch") == 0)   Trans.SetMemPolicy(ChessHeapClass::MEM_FIRST_TOUCH);
+        else if (strcmp(value, "Malloc") == 0)  Trans.SetMemPolicy(ChessHeapClass::MEM_MALLOC);
+        else                                    Trans.SetMemPolicy(ChessHeapClass::MEM_INTERLEAVE);
+        printf("info string hash memory: %s\n", Trans.MemMode());
+    } else if (strcmp(name, "shared hash") == 0)                             {
+        Trans.SetShared(value);
+        printf("info string hash memory: %s\n", Trans.MemMode());
 #ifdef USE_THREADS
     } else if (strcmp(name, "threads") == 0 && Glob.threadOverride == 0)     {
-        Glob.thread_no = (atoi(value));
-        if (Glob.thread_no > MAX_THREADS) Glob.thread_no = MAX_THREADS;
-
-        if (Glob.thread_no != (int)Engines.size()) {
-            Engines.clear();
-            for (int i = 0; i < Glob.thread_no; i++)
-                Engines.emplace_back(i);
-        }
+        SetThreads(atoi(value));
+    } else if (strcmp(name, "thread binding") == 0)                          {
+        if (strcmp(value, "Cores") == 0)        Glob.thread_binding = BIND_CORES;
+        else if (strcmp(value, "Nodes") == 0)   Glob.thread_binding = BIND_NODES;
+        else                                    Glob.thread_binding = BIND_NONE;
+        BindThreads();
 #endif
     } else if (strcmp(name, "clear hash") == 0)                              {
         Trans.Clear();
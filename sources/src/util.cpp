@@ -16,6 +16,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -26,6 +27,11 @@ If not, see <http://www.gnu.org/licenses/>.
     #include <wordexp.h>
 #endif
 
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
 #include "rodent.h"
 
 bool InputAvailable() {
@@ -107,6 +113,18 @@ void POS::InitPawnKey() {
     mPawnKey = key;
 }
 
+void POS::InitMaterialKey() {
+
+    U64 key = 0;
+
+    for (int sd = 0; sd < 2; sd++)
+        for (int tp = 0; tp < 6; tp++)
+            for (int i = 0; i < mCnt[sd][tp]; i++)
+                key ^= msZobMaterial[Pc(sd, tp)][i];
+
+    mMaterialKey = key;
+}
+
 void PrintMove(int move) {
 
     char moveString[6];
@@ -284,3 +302,148 @@ bool ChDir(const char *new_path) {
     return chdir(new_path) == 0;
 }
 #endif
+
+#if defined(__linux__)
+
+// Reads a sysfs id list such as "0-3,8,10-11" into list[]; returns the number of ids read
+
+int ReadSysList(const char *path, int *list, int max) {
+
+    int count = 0;
+    char line[4096];
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) return 0;
+    if (fgets(line, sizeof(line), f)) {
+        for (char *ptr = line; *ptr >= '0' && *ptr <= '9'; ) {
+            int first = (int)strtol(ptr, &ptr, 10), last = first;
+            if (*ptr == '-') last = (int)strtol(ptr + 1, &ptr, 10);
+            for (int id = first; id <= last && count < max; id++)
+                list[count++] = id;
+            if (*ptr == ',') ptr++;
+        }
+    }
+    fclose(f);
+    return count;
+}
+
+#endif
+
+#if defined(__linux__) && defined(USE_THREADS)
+
+// The CPUs the process may run on are put in an order that sends consecutive
+// search threads to different NUMA nodes and uses up the physical cores before
+// their SMT siblings. Thread n is then bound either to the n-th CPU of that
+// order (BIND_CORES) or to all CPUs of its node (BIND_NODES).
+
+static int bind_order[CPU_SETSIZE];     // usable CPUs in the order threads get them
+static int bind_node[CPU_SETSIZE];      // node index of each CPU
+static int bind_cpus = -1;              // number of usable CPUs, -1 until detected
+static int bind_nodes;                  // number of NUMA nodes
+static cpu_set_t bind_default;          // affinity the process was started with
+
+static void DetectTopology() {
+
+    static int cpus[CPU_SETSIZE], siblings[CPU_SETSIZE], smt_rank[CPU_SETSIZE];
+    static bool used[CPU_SETSIZE];
+    int nodes[64], max_rank = 0;
+    char path[128];
+
+    if (sched_getaffinity(0, sizeof(bind_default), &bind_default) != 0)
+        CPU_ZERO(&bind_default);
+
+    const int cpu_cnt = ReadSysList("/sys/devices/system/cpu/online", cpus, CPU_SETSIZE);
+
+    bind_nodes = ReadSysList("/sys/devices/system/node/online", nodes, 64);
+    if (bind_nodes == 0) { // kernel without NUMA support
+        bind_nodes = 1;
+        nodes[0] = 0;
+    }
+
+    for (int i = 0; i < CPU_SETSIZE; i++)
+        bind_node[i] = 0;
+
+    for (int i = 0; i < bind_nodes; i++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes[i]);
+        const int cnt = ReadSysList(path, siblings, CPU_SETSIZE);
+        for (int j = 0; j < cnt; j++)
+            bind_node[siblings[j]] = i;
+    }
+
+    // SMT rank of a CPU is its position among the hardware threads of its core
+
+    for (int i = 0; i < cpu_cnt; i++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpus[i]);
+        const int cnt = ReadSysList(path, siblings, CPU_SETSIZE);
+        smt_rank[i] = 0;
+        for (int j = 0; j < cnt; j++)
+            if (siblings[j] == cpus[i]) smt_rank[i] = j;
+        max_rank = Max(max_rank, smt_rank[i]);
+        used[i] = !CPU_ISSET(cpus[i], &bind_default);
+    }
+
+    // deal CPUs out to nodes round-robin, one SMT rank at a time
+
+    bind_cpus = 0;
+    for (int rank = 0; rank <= max_rank; rank++) {
+        for (bool found = true; found; ) {
+            found = false;
+            for (int node = 0; node < bind_nodes; node++)
+                for (int i = 0; i < cpu_cnt; i++)
+                    if (!used[i] && smt_rank[i] == rank && bind_node[cpus[i]] == node) {
+                        used[i] = true;
+                        bind_order[bind_cpus++] = cpus[i];
+                        found = true;
+                        break;
+                    }
+        }
+    }
+}
+
+static void BindThisThread(int thread_id) {
+
+    cpu_set_t set = bind_default;
+
+    if (Glob.thread_binding != BIND_NONE && bind_cpus > 0) {
+        const int cpu = bind_order[thread_id % bind_cpus];
+
+        CPU_ZERO(&set);
+        if (Glob.thread_binding == BIND_CORES)
+            CPU_SET(cpu, &set);
+        else for (int i = 0; i < bind_cpus; i++)
+            if (bind_node[bind_order[i]] == bind_node[cpu])
+                CPU_SET(bind_order[i], &set);
+    }
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Each search thread binds itself, so this is also the place to rebind
+// after the thread pool has been recreated
+
+void BindThreads() {
+
+    if (bind_cpus < 0)
+        DetectTopology();
+
+    int thread_id = 0;
+    for (auto& engine : Engines) {
+        const int id = thread_id++;
+        engine.StartTask([id] { BindThisThread(id); });
+    }
+
+    for (auto& engine : Engines)
+        engine.WaitTask();
+
+    if (Glob.thread_binding == BIND_NONE)
+        printf("info string thread binding: none\n");
+    else
+        printf("info string thread binding: %d threads to %s, %d cpus on %d numa nodes\n", (int)Engines.size(),
+               Glob.thread_binding == BIND_CORES ? "cores" : "nodes", bind_cpus, bind_nodes);
+}
+
+#else
+
+void BindThreads() {}
+
+#endif